@@ -0,0 +1,328 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// batch.c: decoding many logs at once, one process per log
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+#include <dirent.h>
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+//
+// --batch decodes a whole directory of logs in one go. The CRC tables are
+// built once, then a process is forked for every log, --jobs of them at a
+// time. Each log starts from a clean state, just like a run of its own,
+// and a log that makes its process exit with an error only fails itself.
+// The biggest logs are started first and the small ones fill the gaps at
+// the end, so that no core sits idle while one big log started last is
+// still being decoded.
+//
+// The processes leave their results, and the ICAO addresses they saw, in
+// memory shared with the parent, which prints the report once all are done.
+//
+
+#define BATCH_ICAO_WORDS (BATCH_ICAO_BITS / 64)
+
+static struct {
+    char     **files;               // Logs, in name order
+    int        nfiles;
+    struct batchresult *results;    // Shared, one per log
+    _Atomic uint64_t   *icaos;      // Shared, addresses seen in any log
+    uint64_t  *seen;                // Addresses seen in the log being decoded
+} batch;
+
+// Names ending like an output are outputs of an earlier run. Those of a
+// run with other outputs are told by their content, see inputIsLog()
+static int batchIsOutput(const char *path) {
+    size_t len = strlen(path);
+    int j;
+
+    for (j = 0; j < Modes.nsinks; j++) {
+        size_t n = strlen(Modes.sinks[j].path);
+        if (len > n && !strcmp(path + len - n, Modes.sinks[j].path))
+            return 1;
+    }
+    if (Modes.filename_extract && len > strlen(Modes.filename_extract) &&
+        !strcmp(path + len - strlen(Modes.filename_extract), Modes.filename_extract))
+        return 1;
+    if (Modes.filename_kml && len > strlen(Modes.filename_kml) &&
+        !strcmp(path + len - strlen(Modes.filename_kml), Modes.filename_kml))
+        return 1;
+    return 0;
+}
+
+static void batchAddFile(const char *path) {
+    struct stat st;
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || batchIsOutput(path) || !inputIsLog(path))
+        return;
+
+    batch.files = realloc(batch.files, (batch.nfiles + 1) * sizeof(char *));
+    batch.files[batch.nfiles++] = strdup(path);
+}
+
+static int batchCompareNames(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+// Every regular file of a directory (but hidden ones), or what a pattern matches
+static void batchFindFiles(const char *pattern) {
+    struct stat st;
+
+    if (stat(pattern, &st) == 0 && S_ISDIR(st.st_mode)) {
+        struct dirent *e;
+        DIR *d = opendir(pattern);
+
+        if (d == NULL) {
+            fprintf(stderr, "Error. Unable to read directory %s\n", pattern);
+            exit(1);
+        }
+        while ((e = readdir(d)) != NULL) {
+            char *path;
+
+            if (e->d_name[0] == '.')
+                continue;
+            path = malloc(strlen(pattern) + strlen(e->d_name) + 2);
+            sprintf(path, "%s/%s", pattern, e->d_name);
+            batchAddFile(path);
+            free(path);
+        }
+        closedir(d);
+    } else {
+        glob_t g;
+        size_t i;
+
+        if (glob(pattern, 0, NULL, &g) == 0) {
+            for (i = 0; i < g.gl_pathc; i++)
+                batchAddFile(g.gl_pathv[i]);
+        }
+        globfree(&g);
+    }
+
+    qsort(batch.files, batch.nfiles, sizeof(char *), batchCompareNames);
+}
+
+void batchAddIcao(uint32_t addr) {
+    if (addr & MODES_NON_ICAO_ADDRESS)
+        return;
+    batch.seen[addr >> 6] |= (uint64_t) 1 << (addr & 63);
+}
+
+// The forked process: decode one log and leave the results
+static void batchWorker(int i) {
+    struct batchresult *r = &batch.results[i];
+    uint64_t start = mstime();
+    int w;
+
+    Modes.filenames = &batch.files[i];
+    Modes.nfilenames = 1;
+    Modes.batch_input = batch.files[i];
+
+    batch.seen = calloc(BATCH_ICAO_WORDS, sizeof(uint64_t));
+    if (!batch.seen) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+
+    blackboxDecode();
+
+    for (w = 0; w < BATCH_ICAO_WORDS; w++) {
+        if (batch.seen[w]) {
+            r->icaos += __builtin_popcountll(batch.seen[w]);
+            atomic_fetch_or(&batch.icaos[w], batch.seen[w]);
+        }
+    }
+    r->messages = Modes.msg_processed;
+    r->extracted = Modes.msg_extracted;
+    r->bad_crc = Modes.err_bad_crc;
+    r->not_known_icao = Modes.err_not_known_ICAO;
+    r->msecs = mstime() - start;
+    r->done = !Modes.exit;
+
+    for (w = 0; w < Modes.ninputs; w++)
+        inputClose(&Modes.inputs[w]);
+    exit(0);
+}
+
+static uint64_t batchFileSize(const char *path) {
+    struct stat st;
+
+    return stat(path, &st) == 0 ? (uint64_t) st.st_size : 0;
+}
+
+int batchRun(void) {
+    struct { uint64_t size; int index; } *order, t;
+    struct batchresult total;
+    size_t shared;
+    uint64_t start = mstime(), unique = 0;
+    pid_t *pids;
+    int jobs, next = 0, running = 0, failed = 0;
+    int i, j;
+
+    if (Modes.nfilenames || Modes.connect || Modes.follow || Modes.filename_checkpoint || Modes.filename_archive || Modes.record) {
+        fprintf(stderr, "\nERROR: --batch can't be used with --filename, --connect, --follow, --checkpoint, --archive or --record.\n\n");
+        exit(1);
+    }
+    if (Modes.blackbox) {
+        fprintf(stderr, "\nERROR: --batch can't be used with --blackbox.\n\n");
+        exit(1);
+    }
+    if (Modes.replay_port || Modes.net_sbs_port) {
+        fprintf(stderr, "\nERROR: --batch can't serve logs to TCP clients, use --replay-tcp on a log at a time.\n\n");
+        exit(1);
+    }
+    for (j = 0; j < Modes.nsinks; j++) {
+        if (!strcmp(Modes.sinks[j].path, "-")) {
+            fprintf(stderr, "\nERROR: with --batch outputs are written next to each log, not to stdout.\n\n");
+            exit(1);
+        }
+        if (!strncmp(Modes.sinks[j].path, "tcp:", 4)) {
+            fprintf(stderr, "\nERROR: --batch can't serve logs to TCP clients, use --replay-tcp on a log at a time.\n\n");
+            exit(1);
+        }
+    }
+
+    batchFindFiles(Modes.batch);
+    if (!batch.nfiles) {
+        fprintf(stderr, "Error. No logs found in %s\n", Modes.batch);
+        exit(1);
+    }
+
+    jobs = Modes.batch_jobs ? Modes.batch_jobs : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1)
+        jobs = 1;
+
+    // Each log is decoded on one thread, the parallelism is in the logs,
+    // and the decoded messages only go to the files
+    Modes.no_pipeline = 1;
+    Modes.quiet = 1;
+
+    shared = batch.nfiles * sizeof(struct batchresult) + BATCH_ICAO_WORDS * sizeof(uint64_t);
+    batch.results = mmap(NULL, shared, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (batch.results == MAP_FAILED) {
+        fprintf(stderr, "Error. Unable to map shared memory: %s\n", strerror(errno));
+        exit(1);
+    }
+    batch.icaos = (_Atomic uint64_t *) (batch.results + batch.nfiles);
+
+    // Biggest first
+    order = malloc(batch.nfiles * sizeof(*order));
+    pids = calloc(batch.nfiles, sizeof(pid_t));
+    if (!order || !pids) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < batch.nfiles; i++) {
+        order[i].size = batchFileSize(batch.files[i]);
+        order[i].index = i;
+    }
+    for (i = 1; i < batch.nfiles; i++) {
+        for (j = i; j > 0 && order[j - 1].size < order[j].size; j--) {
+            t = order[j]; order[j] = order[j - 1]; order[j - 1] = t;
+        }
+    }
+
+    printf("Decoding %d logs, %d at a time\n", batch.nfiles, jobs);
+    fflush(stdout);
+    fflush(stderr);
+
+    for (;;) {
+        int status;
+        pid_t pid;
+
+        while (running < jobs && next < batch.nfiles && !Modes.exit) {
+            i = order[next++].index;
+            pid = fork();
+            if (pid < 0) {
+                fprintf(stderr, "Error. Unable to start a process: %s\n", strerror(errno));
+                exit(1);
+            }
+            if (pid == 0)
+                batchWorker(i);
+            pids[i] = pid;
+            running++;
+        }
+        if (!running)
+            break;
+
+        pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (i = 0; i < batch.nfiles; i++) {
+            if (pids[i] == pid) {
+                batch.results[i].status = status;
+                running--;
+                break;
+            }
+        }
+    }
+
+    // Report, in name order
+    printf("\n");
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < batch.nfiles; i++) {
+        struct batchresult *r = &batch.results[i];
+        int status = r->status;
+
+        printf("%s: ", batch.files[i]);
+        if (!pids[i]) {
+            printf("not started\n");
+            failed++;
+            continue;
+        }
+        if (WIFSIGNALED(status)) {
+            printf("FAILED, killed by signal %d\n", WTERMSIG(status));
+            failed++;
+            continue;
+        }
+        if (WEXITSTATUS(status) != 0) {
+            printf("FAILED, exit status %d\n", WEXITSTATUS(status));
+            failed++;
+            continue;
+        }
+
+        printf("%llu messages, %u ICAOs", r->messages, r->icaos);
+        if (r->bad_crc) printf(", %d bad CRC", r->bad_crc);
+        if (r->not_known_icao) printf(", %d not validated", r->not_known_icao);
+        printf(", %.1f s%s\n", r->msecs / 1000.0, r->done ? "" : ", interrupted");
+        if (!r->done)
+            failed++;
+
+        total.messages += r->messages;
+        total.extracted += r->extracted;
+        total.bad_crc += r->bad_crc;
+        total.not_known_icao += r->not_known_icao;
+    }
+    for (j = 0; j < BATCH_ICAO_WORDS; j++)
+        unique += __builtin_popcountll(atomic_load(&batch.icaos[j]));
+
+    printf("\nDecoded %d of %d logs in %.1f s\n", batch.nfiles - failed, batch.nfiles, (mstime() - start) / 1000.0);
+    if (total.extracted) printf("Extracted %llu messages\n", total.extracted);
+    printf("Total processed %llu messages\n", total.messages);
+    if (total.bad_crc) printf("WARNING! Found %d messages with bad CRC\n", total.bad_crc);
+    if (total.not_known_icao) printf("WARNING! Found %d messages that might be valid, but we couldn't validate the CRC against a known ICAO\n", total.not_known_icao);
+    printf("Total found %llu unique ICAOs\n", (long long unsigned) unique);
+
+    munmap(batch.results, shared);
+    free(order);
+    free(pids);
+    return failed;
+}
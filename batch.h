@@ -0,0 +1,47 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// batch.h: decoding many logs at once, one process per log
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BATCH_H_INCLUDED
+#define BATCH_H_INCLUDED
+
+#include <stdint.h>
+
+/* Bits of the set of ICAO addresses seen */
+#define BATCH_ICAO_BITS  (1 << 24)
+
+/* Outcome of one log, filled in by the process that decoded it */
+struct batchresult {
+    int      done;              // Decoded to the end (or to --max-messages)
+    int      status;            // Exit status of its process
+    uint64_t msecs;             // Decoding time
+    long long unsigned messages;
+    long long unsigned extracted;
+    int      bad_crc;
+    int      not_known_icao;
+    uint32_t icaos;             // Unique ICAO addresses
+};
+
+// --batch: decode every log of a directory or pattern, then print a
+// report. Returns the number of logs that could not be decoded.
+int batchRun(void);
+
+// Note an address seen in the log being decoded
+void batchAddIcao(uint32_t addr);
+
+#endif // BATCH_H_INCLUDED
@@ -41,14 +41,14 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 #include "beastblackbox.h"
+#include <glob.h>
 
 
 //
 // ============================= Utility functions ==========================
 //
-void sigintHandler(int dummy) {
-    MODES_NOTUSED(dummy);
-    signal(SIGINT, SIG_DFL);  // reset signal handler - bit extra safety
+void sigintHandler(int sig) {
+    signal(sig, SIG_DFL);     // reset signal handler - bit extra safety
     Modes.exit = 1;           // Signal to threads that we are done
 }
 //
@@ -61,8 +61,36 @@ void blackboxInitConfig(void) {
 
     memset(&Modes,    0, sizeof(Modes));
     Modes.mlat_decoder			  = MLAT_NONE;
-	Modes.MLATtimefunc 			  = &MLATtime_none;
     Modes.check_crc               = 1;
+    Modes.tracker_threads         = 1;
+    Modes.replay_speed            = 1.0;
+    Modes.blackbox_before         = BLACKBOX_BEFORE_MIN;
+    Modes.blackbox_after          = BLACKBOX_AFTER_MIN;
+    Modes.blackbox_size           = BLACKBOX_SIZE_MB;
+    Modes.blackbox_triggers       = BLACKBOX_ALL;
+    Modes.record_sync             = RECORD_SYNC_SEC;
+    Modes.record_rotate           = RECORD_ROTATE_MIN;
+    Modes.record_fsync            = RECORD_FSYNC_SEC;
+}
+
+//
+// Add input files to the list. Patterns are expanded here too, so they
+// can be quoted to get past the shell's argument limit.
+//
+static void addInputFiles(const char *pattern) {
+	glob_t g;
+	size_t i;
+
+	if (glob(pattern, GLOB_NOCHECK, NULL, &g) != 0) {
+		fprintf(stderr, "Error. Unable to expand file name %s\n", pattern);
+		exit(1);
+	}
+
+	Modes.filenames = realloc(Modes.filenames, (Modes.nfilenames + g.gl_pathc) * sizeof(char *));
+	for (i = 0; i < g.gl_pathc; i++) {
+		Modes.filenames[Modes.nfilenames++] = strdup(g.gl_pathv[i]);
+	}
+	globfree(&g);
 }
 
 //
@@ -75,18 +103,50 @@ void showHelp(void) {
 "-----------------------------------------------------------------------------\n"
 "Build: %s\n\n"
 
-  "--filename <file>        Source file to proceed\n"
+  "--filename <file> ...    Source file(s) to proceed, several files (or patterns) are merged by time,\n"
+  "                         - for standard input (named pipes work too)\n"
+  "--connect <host:port>    Read BEAST from a feeder (e.g. dump1090 port 30005), connecting again when lost\n"
+  "--archive <file>         Append the BEAST data read to the file, e.g. to keep what --connect received\n"
+  "--record <prefix>        Write the BEAST data read to <prefix>-beast-bin-utc--<time>--.log with wall clock sync records\n"
+  "--record-sync <sec>      Seconds between sync records (default: 10)\n"
+  "--record-rotate <min>    Minutes per log, 0 for one log (default: 60)\n"
+  "--record-fsync <sec>     Longest time the data read stays in memory before a write and fdatasync (default: 10)\n"
+  "--follow                 Keep reading as the file grows, like tail -f (survives log rotation)\n"
+  "--batch <dir|pattern>    Decode each log of a directory (or matching a pattern) on its own, output names\n"
+  "                         are added to each log name (--output sbs:.sbs writes radar.log.sbs)\n"
+  "--jobs <n>               Logs decoded at the same time with --batch, threads of --only-find-icaos (default: number of CPUs)\n"
   "--extract <file>         Extract BEAST data to new file (if no ICAO filter specified it just copies the source)\n"
   "--only-find-icaos        Find all unique ICAOs in the file and print ICAOs list (WARNING: also shows non-ICAO!)\n"
-  "--export-kml <file>      Export coordinates and height to KML (WARNING: works only with --filter-icao)\n"
+  "--export-kml <file>      Export coordinates and height to KML, a flight per Placemark (.kmz is zipped)\n"
+  "--replay-tcp <port>      Replay the (filtered) BEAST frames to TCP clients on localhost at the pace of the log\n"
+  "--net-sbs-port <port>    Serve SBS messages to TCP clients on [address:]port (e.g. 30003), slow clients are disconnected\n"
+  "--replay-speed <x>       Pace of the network outputs from a log, 0.5 to 100, or max for as fast as possible (default: 1)\n"
+  "--replay-policy <p>      Client that doesn't keep up: drop (its frames, default), disconnect or block (everybody)\n"
+  "--blackbox <dir>         Keep the last minutes of frames in memory, write them to the directory on an event\n"
+  "--blackbox-before <min>  Minutes recorded before the event (default: 10)\n"
+  "--blackbox-after <min>   Minutes recorded after the last event (default: 5)\n"
+  "--blackbox-size <MiB>    Memory for the frames kept (default: 64)\n"
+  "--blackbox-triggers <l>  Events, comma separated: squawk (7500/7600/7700), alert, spi, acas (RA), signal (SIGUSR1) or all (default)\n"
+  "--simplify <metres>      Drop track points that are within this distance of the simplified track\n"
   "--mlat-time <type>       Decode MLAT timestamps in specified manner. Types are: none (default), beast, dump1090\n"
   "--init-time-unix <sec>   Start time (UNIX epoch, format: ss.ms) to calculate realtime using MLAT timestamps\n"
-  "--localtime              Decode time as local time (default: UTC)\n"
+  "                         (default: the time in the log name, as in ulss7-beast-bin-utc--1522782148.136310917--.log)\n"
+  "--mlat-drift             Estimate the rate of the dump1090 clock from the sync records of --record\n"
+  "--localtime              Decode time as local time (default: UTC)\n"
   "--sbs-output             Show messages in SBS format (default: dump1090 style)\n"
+  "--json-output            Show messages as JSON, one object per line\n"
+  "--output <fmt>:<file>[,icao=<addr>][,df=<n>][,simplify=<metres>][,policy=<p>]\n"
+  "                         Also write messages to a file, or to TCP clients with tcp:[address:]port, may be repeated. Formats: sbs, verbose, json, kml, kmz, gxtrack, geojson, columns, beast, replay\n"
   "--filter-icao <addr>     Show only messages from the given ICAO\n"
   "--max-messages <count>   Limit messages count from the start of the file (default: all)\n"
   "--show-progress          Show progress during file operation\n"
-  "--quiet                  Do not output decoded messages to stdout (useful for --extract and --export-kml)\n\n"
+  "--checkpoint <file>      Resume from the state saved in the file and save it again at exit\n"
+  "--pack <file>            Write the input to a packed archive, nothing else is done\n"
+  "--unpack <file>          Write a packed archive back to BEAST, nothing else is done\n"
+  "--quiet                  Do not output decoded messages to stdout (useful for --extract and --export-kml)\n"
+  "--sync-output            Write output while decoding instead of in a separate writer thread\n"
+  "--no-pipeline            Decode, track and write on one thread instead of one thread per stage\n"
+  "--tracker-threads <n>    Split aircraft tracking over n threads by address (default: 1)\n\n"
   "Additional BEAST options:\n"
   "--modeac                 Enable decoding of SSR modes 3/A & 3/C\n"
   "--gnss                   Show altitudes as HAE/GNSS (with H suffix) when available\n"
@@ -104,104 +164,236 @@ void showHelp(void) {
 //
 void blackboxInit(void) {
 
-	struct tm stTime_init;
+	int j;
 
-    // Prepare error correction tables
-    modesChecksumInit(Modes.nfix_crc);
     icaoFilterInit();
 
-    Modes.input_bb = -1;
-    Modes.output_bb = -1;
-	Modes.output_kml = NULL;
-
-	if (Modes.filename == NULL) {
+	if (Modes.nfilenames == 0 && Modes.connect == NULL) {
 			showHelp();
 			fprintf(stderr, "\nERROR: no file specified. Nothing to do. Use --filename option or --help for more info.\n\n");
             exit(1);
 	}
 
-	if((Modes.filename_kml != NULL) && (!Modes.show_only)) {
-		    showHelp();
-			fprintf(stderr, "\nERROR: no filter ICAO specified. Option --export-kml works only with --filter-icao. Use --help for more info\n\n");
+	if ((Modes.nfilenames > 1) && (Modes.follow || Modes.filename_checkpoint != NULL)) {
+			fprintf(stderr, "\nERROR: --follow and --checkpoint work with a single input file only.\n\n");
 			exit(1);
 	}
 
-   // Init the files
-	Modes.input_bb = open(Modes.filename, O_RDONLY);
-    if (Modes.input_bb == -1) {
-            fprintf(stderr, "Error. Unable to open for read BEAST file %s\n",Modes.filename);
-            exit(1);
-    }
+	if (Modes.connect != NULL && (Modes.nfilenames || Modes.follow || Modes.filename_checkpoint != NULL)) {
+			fprintf(stderr, "\nERROR: --connect reads a single feeder, without --filename, --follow or --checkpoint.\n\n");
+			exit(1);
+	}
 
-	if (Modes.filename_extract != NULL) {
-		Modes.output_bb = open(Modes.filename_extract, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-		if (Modes.output_bb == -1) {
-            fprintf(stderr, "Error. Unable to open for write BEAST file %s\n",Modes.filename_extract);
-            exit(1);
+	if ((Modes.nfilenames > 1) && Modes.filename_archive != NULL) {
+			fprintf(stderr, "\nERROR: --archive works with a single input only.\n\n");
+			exit(1);
+	}
+
+	if ((Modes.nfilenames > 1) && Modes.record != NULL) {
+			fprintf(stderr, "\nERROR: --record works with a single input only.\n\n");
+			exit(1);
+	}
+
+   // Init the files
+	if (Modes.connect != NULL) {
+		Modes.ninputs = 1;
+		Modes.inputs = calloc(1, sizeof(struct beastinput));
+		inputConnect(&Modes.inputs[0], Modes.connect, 0);
+	} else {
+		Modes.ninputs = Modes.nfilenames;
+		Modes.inputs = calloc(Modes.ninputs, sizeof(struct beastinput));
+		for (j = 0; j < Modes.ninputs; j++) {
+			inputOpen(&Modes.inputs[j], Modes.filenames[j], j);
 		}
 	}
 
-	if (Modes.filename_kml != NULL) {
-        Modes.output_kml = fopen(Modes.filename_kml, "w");
-		if (Modes.output_kml == NULL) {
-            fprintf(stderr, "Error. Unable to open for write KML file %s\n",Modes.filename_extract);
-            exit(1);
+	if (Modes.filename_archive != NULL) {
+		inputArchive(&Modes.inputs[0], Modes.filename_archive);
+	}
+
+	if (Modes.record != NULL) {
+		Modes.inputs[0].record = recordOpen(Modes.record, (uint64_t) (Modes.record_sync * 1e9),
+		                                    (uint64_t) (Modes.record_rotate * 60e9), (uint64_t) (Modes.record_fsync * 1e9));
+	}
+
+	// Every input starts at its own time: logs named after the time they
+	// start need no --init-time-unix, which is for a single log the one to
+	// go by. The dump1090 clocks of several receivers have nothing in
+	// common, so such logs are only merged when each has a time of its own.
+	for (j = 0; j < Modes.ninputs; j++) {
+		struct beastinput *in = &Modes.inputs[j];
+		struct timespec ts = Modes.baseTime, named;
+		int own = (Modes.connect == NULL && timeFromFilename(in->filename, &named));
+
+		if (own && (Modes.ninputs > 1 || (!ts.tv_sec && !ts.tv_nsec)))
+			ts = named;
+		if (Modes.mlat_decoder == MLAT_DUMP1090 && Modes.ninputs > 1 && !own) {
+			fprintf(stderr, "Error. %s has no start time in its name (--<seconds>.<nanoseconds>--), "
+			        "logs with dump1090 clocks can't be merged without one each\n", in->filename);
+			exit(1);
 		}
-		writeKMLpreamble(Modes.output_kml, Modes.show_only);
+		mlatClockInit(&in->clock, (Modes.mlat_decoder != MLAT_NONE) ? &ts : NULL);
 	}
 
-	if((Modes.mlat_decoder == MLAT_BEAST) && Modes.baseTime.tv_sec) {
-		gmtime_r(&Modes.baseTime.tv_sec, &stTime_init);
-		stTime_init.tm_hour = 0;
-		stTime_init.tm_min = 0;
-		stTime_init.tm_sec = 0;
-		Modes.baseTime.tv_sec = mktime(&stTime_init) + time_offset();
+	if (Modes.filename_checkpoint != NULL) {
+		checkpointLoad();
 	}
+
+	outWriterStart(!Modes.sync_output);
+	outInit(&Modes.out, stdout);
+	sinkOpenAll();
+}
+
+//
+// Decode the inputs to the outputs
+//
+void blackboxDecode(void) {
+
+    blackboxInit();
+
+    pipelineStart();
+    readbeastfile();
+    pipelineStop();
+    sinkFinishAll();
+    outFree(&Modes.out);
+    outWriterStop();
+    sinkCloseAll();
 }
 
 int main(int argc, char **argv) {
     // Initialization
     int j;
-	double t;
+	struct recordstats record_stats;
+	FILE *stats;
 
 	blackboxInitConfig();
 
 
     signal(SIGINT, sigintHandler); // Define Ctrl/C handler (exit program)
+    signal(SIGTERM, sigintHandler); // kill and systemctl stop, flush the logs the same way
+    signal(SIGHUP, sigintHandler);
 
 
     // Parse the command line options
     for (j = 1; j < argc; j++) {
-        int more = ((j + 1) < argc); // There are more arguments
+        int more = ((j + 1) < argc); // There are more arguments
 
 		if (!strcmp(argv[j],"--modeac")) {
             Modes.mode_ac = 1;
 		} else if (!strcmp(argv[j],"--localtime")) {
             Modes.useLocaltime = 1;
 		} else if (!strcmp(argv[j],"--only-find-icaos")) {
-			Modes.find_icao = 1;
+			Modes.find_icao = 1;
         } else if (!strcmp(argv[j],"--init-time-unix") && more) {
-			Modes.baseTime.tv_nsec = (int) (1000000000 * modf(atof(argv[++j]),&t));
-			Modes.baseTime.tv_sec = (int) t;
+			if (!timeParse(argv[++j], &Modes.baseTime)) {
+				fprintf(stderr, "Error. --init-time-unix needs seconds since 1970, e.g. 1522782148.136310917\n");
+				exit(1);
+			}
+		} else if (!strcmp(argv[j],"--mlat-drift")) {
+			Modes.mlat_drift = 1;
 		} else if (!strcmp(argv[j],"--export-kml") && more) {
 			Modes.filename_kml = strdup(argv[++j]);
 	    } else if (!strcmp(argv[j],"--filename") && more) {
-		    Modes.filename = strdup(argv[++j]);
+		    // Everything up to the next option is an input file
+		    while ((j + 1) < argc && strncmp(argv[j+1], "--", 2)) {
+			    addInputFiles(argv[++j]);
+		    }
+	    } else if (!strcmp(argv[j],"--connect") && more) {
+		    Modes.connect = strdup(argv[++j]);
+	    } else if (!strcmp(argv[j],"--archive") && more) {
+		    Modes.filename_archive = strdup(argv[++j]);
+	    } else if (!strcmp(argv[j],"--record") && more) {
+		    Modes.record = strdup(argv[++j]);
+	    } else if (!strcmp(argv[j],"--record-sync") && more) {
+		    Modes.record_sync = atof(argv[++j]);
+		    if (Modes.record_sync <= 0) {
+		        fprintf(stderr, "Error. --record-sync must be more than 0 seconds\n");
+		        exit(1);
+		    }
+	    } else if (!strcmp(argv[j],"--record-rotate") && more) {
+		    Modes.record_rotate = atof(argv[++j]);
+		    if (Modes.record_rotate < 0) {
+		        fprintf(stderr, "Error. --record-rotate must be 0 (one log) or more minutes\n");
+		        exit(1);
+		    }
+	    } else if (!strcmp(argv[j],"--record-fsync") && more) {
+		    Modes.record_fsync = atof(argv[++j]);
+		    if (Modes.record_fsync < 0) {
+		        fprintf(stderr, "Error. --record-fsync must be 0 or more seconds\n");
+		        exit(1);
+		    }
+	    } else if (!strcmp(argv[j],"--checkpoint") && more) {
+		    Modes.filename_checkpoint = strdup(argv[++j]);
+	    } else if (!strcmp(argv[j],"--pack") && more) {
+		    Modes.filename_pack = strdup(argv[++j]);
+	    } else if (!strcmp(argv[j],"--unpack") && more) {
+		    Modes.filename_unpack = strdup(argv[++j]);
+	    } else if (!strcmp(argv[j],"--follow")) {
+		    Modes.follow = 1;
 	    } else if (!strcmp(argv[j],"--mlat-time") && more) {
 	    	++j;
 	    	if (!strcmp(argv[j],"beast")) {
 	    		Modes.mlat_decoder = MLAT_BEAST;
-	    		Modes.MLATtimefunc = &MLATtime_beast;
 	    	} else if (!strcmp(argv[j],"dump1090")) {
 	    		Modes.mlat_decoder = MLAT_DUMP1090;
-	    		Modes.MLATtimefunc = &MLATtime_dump1090;
 	    	} else if (!strcmp(argv[j],"none")) {
 	    		Modes.mlat_decoder = MLAT_NONE;
-	    		Modes.MLATtimefunc = &MLATtime_none;
 	    	} else {
 	    		fprintf(stderr, "Unknown argument for option --mlat-time: '%s'.\n\n", argv[j]);
 	    		exit(1);
 	    	}
+		} else if (!strcmp(argv[j],"--simplify") && more) {
+		    Modes.simplify = atof(argv[++j]);
+		} else if (!strcmp(argv[j],"--output") && more) {
+		    sinkAdd(argv[++j]);
+		} else if (!strcmp(argv[j],"--replay-tcp") && more) {
+		    Modes.replay_port = strdup(argv[++j]);
+		} else if (!strcmp(argv[j],"--replay-speed") && more) {
+		    j++;
+		    if (!strcmp(argv[j], "max")) {
+		        Modes.replay_speed = 0;
+		    } else {
+		        Modes.replay_speed = atof(argv[j]);
+		        if (Modes.replay_speed < 0.5 || Modes.replay_speed > 100) {
+		            fprintf(stderr, "Error. --replay-speed must be between 0.5 and 100, or max\n");
+		            exit(1);
+		        }
+		    }
+		} else if (!strcmp(argv[j],"--replay-policy") && more) {
+		    int policy = netPolicy(argv[++j]);
+		    if (policy < 0) {
+		        fprintf(stderr, "Error. Unknown replay policy '%s', use drop, disconnect or block\n", argv[j]);
+		        exit(1);
+		    }
+		    Modes.replay_policy = policy;
+		} else if (!strcmp(argv[j],"--net-sbs-port") && more) {
+		    Modes.net_sbs_port = strdup(argv[++j]);
+		} else if (!strcmp(argv[j],"--blackbox") && more) {
+		    Modes.blackbox = strdup(argv[++j]);
+		} else if (!strcmp(argv[j],"--blackbox-before") && more) {
+		    Modes.blackbox_before = atof(argv[++j]);
+		    if (Modes.blackbox_before <= 0) {
+		        fprintf(stderr, "Error. --blackbox-before must be more than 0 minutes\n");
+		        exit(1);
+		    }
+		} else if (!strcmp(argv[j],"--blackbox-after") && more) {
+		    Modes.blackbox_after = atof(argv[++j]);
+		    if (Modes.blackbox_after <= 0) {
+		        fprintf(stderr, "Error. --blackbox-after must be more than 0 minutes\n");
+		        exit(1);
+		    }
+		} else if (!strcmp(argv[j],"--blackbox-size") && more) {
+		    Modes.blackbox_size = atoi(argv[++j]);
+		    if (Modes.blackbox_size < 1) {
+		        fprintf(stderr, "Error. --blackbox-size must be at least 1 MiB\n");
+		        exit(1);
+		    }
+		} else if (!strcmp(argv[j],"--blackbox-triggers") && more) {
+		    Modes.blackbox_triggers = blackboxTriggers(argv[++j]);
+		    if (Modes.blackbox_triggers < 0) {
+		        fprintf(stderr, "Error. Unknown black box trigger in '%s', use squawk, alert, spi, acas, signal or all\n", argv[j]);
+		        exit(1);
+		    }
 		} else if (!strcmp(argv[j],"--extract") && more) {
 		    Modes.filename_extract = strdup(argv[++j]);
 		} else if (!strcmp(argv[j],"--filter-icao") && more) {
@@ -210,6 +402,22 @@ int main(int argc, char **argv) {
             Modes.max_messages = strtoul(argv[++j],NULL, 10);
         } else if (!strcmp(argv[j],"--sbs-output")) {
             Modes.sbs_output = 1;
+        } else if (!strcmp(argv[j],"--json-output")) {
+            Modes.json_output = 1;
+        } else if (!strcmp(argv[j],"--sync-output")) {
+            Modes.sync_output = 1;
+        } else if (!strcmp(argv[j],"--no-pipeline")) {
+            Modes.no_pipeline = 1;
+        } else if (!strcmp(argv[j],"--batch") && more) {
+            Modes.batch = strdup(argv[++j]);
+        } else if (!strcmp(argv[j],"--jobs") && more) {
+            Modes.batch_jobs = atoi(argv[++j]);
+        } else if (!strcmp(argv[j],"--tracker-threads") && more) {
+            Modes.tracker_threads = atoi(argv[++j]);
+            if (Modes.tracker_threads < 1 || Modes.tracker_threads > MAX_TRACKER_THREADS) {
+                fprintf(stderr, "Error. --tracker-threads must be 1 to %d\n", MAX_TRACKER_THREADS);
+                exit(1);
+            }
         } else if (!strcmp(argv[j],"--quiet")) {
             Modes.quiet = 1;
 		} else if (!strcmp(argv[j],"--show-progress")) {
@@ -234,30 +442,60 @@ int main(int argc, char **argv) {
         }
     }
 
-    blackboxInit();
-
+    // Archive conversion only, no decoding
+    if (Modes.filename_pack || Modes.filename_unpack) {
+        packRun();
+        return (0);
+    }
+
+    // Prepare error correction tables
+    modesChecksumInit(Modes.nfix_crc);
+
+    // Many logs, each decoded by a process of its own
+    if (Modes.batch) {
+        return (batchRun() ? 1 : 0);
+    }
+
 	// Main routine
-    readbeastfile();
+    blackboxDecode();
+
+	if (Modes.filename_checkpoint != NULL) {
+		checkpointSave();
+	}
 
-	printf("\n");
+	if (Modes.record != NULL) {
+		recordClose(Modes.inputs[0].record, &record_stats);
+		Modes.inputs[0].record = NULL;
+	}
+
+	// JSON Lines on stdout stay JSON, the statistics go aside
+	stats = sinkJsonOnStdout() ? stderr : stdout;
+
+	fprintf(stats, "\n");
 	if(Modes.find_icao) {
 		icaoPrintDB();
 	} else {
 
-	if (Modes.msg_extracted) printf("Extracted %llu messages\n", Modes.msg_extracted);
-	printf("Total processed %llu messages\n", Modes.msg_processed);
+	if (Modes.msg_extracted) fprintf(stats, "Extracted %llu messages\n", Modes.msg_extracted);
+	fprintf(stats, "Total processed %llu messages\n", Modes.msg_processed);
 
-	if(Modes.err_bad_crc) printf("WARNING! Found %d messages with bad CRC\n", Modes.err_bad_crc);
-	if(Modes.err_not_known_ICAO) printf("WARNING! Found %d messages that might be valid, but we couldn't validate the CRC against a known ICAO\n", Modes.err_not_known_ICAO);
+	if(Modes.err_bad_crc) fprintf(stats, "WARNING! Found %d messages with bad CRC\n", Modes.err_bad_crc);
+	if(Modes.err_not_known_ICAO) fprintf(stats, "WARNING! Found %d messages that might be valid, but we couldn't validate the CRC against a known ICAO\n", Modes.err_not_known_ICAO);
+	}
+	sinkPrintStats(stats);
+	MLATtimePrintStats(stats);
+	if (Modes.record != NULL) {
+		recordPrintStats(stats, &record_stats);
+	}
+	if (Modes.show_progress) {
+		pipelineStats(stats);
+		outWriterStats(stats);
 	}
 
     // Close all files
-    close (Modes.input_bb);
-	close (Modes.output_bb);
-	if(Modes.output_kml != NULL) {
-    writeKMLend(Modes.output_kml);
-    fclose(Modes.output_kml);
-	}
+    for (j = 0; j < Modes.ninputs; j++) {
+        inputClose(&Modes.inputs[j]);
+    }
 
 
     return (0);
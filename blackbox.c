@@ -0,0 +1,428 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// blackbox.c: in-memory recorder of the last minutes, written on events
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+//
+// --blackbox keeps the BEAST frames of the last minutes in a ring allocated
+// once, and writes nothing as long as nothing happens. When a message
+// fires a trigger (an emergency squawk, the alert or SPI flag, an ACAS
+// resolution advisory) or SIGUSR1 comes, the frames of the ring go to a new
+// file of the directory, followed by those of the next minutes; a trigger
+// during a recording makes it longer. On an SD card this is a write now
+// and then instead of a constant stream.
+//
+// The ring is filled by the reader with every frame as it comes, before
+// decoding: those with a bad CRC or an unknown address, Mode A/C, whatever
+// the filters of the outputs. Only the triggers look at the decoded
+// messages, on the output thread; a lock keeps the two apart.
+//
+// Each frame is kept with its time on the receiver clock (the time it is
+// read without --mlat-time) behind a small header. A frame never wraps
+// around the end of the ring, the space left there is skipped.
+//
+
+struct bbheader {
+    uint64_t ms;            // Receiver clock of the frame, see bbClock()
+    uint32_t len;           // Bytes of the frame, BLACKBOX_PAD to skip to the start
+    uint32_t spare;
+};
+
+#define BLACKBOX_PAD 0xffffffffU
+
+struct blackbox {
+    char    *dir;
+    uint64_t before_ms;
+    uint64_t after_ms;
+    int      triggers;
+
+    char    *ring;
+    size_t   size;
+    uint64_t head;          // Positions from the start, the ring offset is modulo size
+    uint64_t tail;          // Oldest frame kept
+
+    // Recording under way, fd -1 when none
+    int      fd;
+    char     name[PATH_MAX];
+    uint64_t until_ms;      // Frames after this time are not recorded
+    uint64_t written;       // Frames before this position are in the file
+    uint64_t bytes;
+    char    *stage;         // Frames copied out of the ring for a write
+    size_t   staged;
+
+    int      signals;       // SIGUSR1 seen so far
+
+    // Receiver clock in ms, made to go on over midnights and wraps
+    uint64_t clock;         // Latest so far
+    uint64_t clock_offset;  // Added to the time of the frames of this day
+    int      clock_started;
+
+    pthread_mutex_t lock;
+    struct blackboxstats stats;
+};
+
+static volatile sig_atomic_t blackbox_signals;
+
+static void blackboxSignal(int dummy)
+{
+    MODES_NOTUSED(dummy);
+    blackbox_signals++;
+}
+
+// Receiver clock of a frame in ms. Beast timestamps restart every day and
+// dump1090 ones wrap after 271 days: a step back of more than half of that
+// is a new period, a step forward as big a late frame of the one before.
+// Frames without a clock take the latest time. A trigger only looks
+// (update 0), the reader moves the clock along.
+static uint64_t bbClock(struct blackbox *bb, uint64_t timestamp, int update)
+{
+    uint64_t raw, period, off = bb->clock_offset, t;
+
+    if (Modes.mlat_decoder == MLAT_NONE)
+        return update ? (bb->clock = mstime()) : bb->clock;
+    if (!timestamp || timestamp == MAGIC_MLAT_TIMESTAMP)
+        return bb->clock;
+
+    if (Modes.mlat_decoder == MLAT_BEAST) {
+        if ((timestamp >> 30) >= 86400)
+            return bb->clock;
+        raw = (timestamp >> 30) * 1000 + (timestamp & BEAST_DROP_UPPER_34_BITS) / 1000000;
+        period = 86400000ULL;
+    } else {
+        raw = (timestamp & 0xFFFFFFFFFFFFULL) / 12000;
+        period = (1ULL << 48) / 12000;
+    }
+
+    t = off + raw;
+    if (bb->clock_started) {
+        if (t + period / 2 < bb->clock)
+            t = (off += period) + raw;
+        else if (t > bb->clock + period / 2 && off >= period)
+            return off - period + raw;
+    }
+    if (update) {
+        bb->clock_offset = off;
+        bb->clock_started = 1;
+        if (t > bb->clock)
+            bb->clock = t;
+    }
+    return t;
+}
+
+static size_t bbRecordSize(uint32_t len)
+{
+    return (sizeof(struct bbheader) + len + 7) & ~(size_t) 7;
+}
+
+// Position of the frame at pos or after the space left at the end
+static uint64_t bbSkip(struct blackbox *bb, uint64_t pos)
+{
+    size_t off;
+
+    while (pos != bb->head) {
+        off = pos % bb->size;
+        if (bb->size - off >= sizeof(struct bbheader) &&
+            ((struct bbheader *) (bb->ring + off))->len != BLACKBOX_PAD)
+            break;
+        pos += bb->size - off;
+    }
+    return pos;
+}
+
+static void bbStop(struct blackbox *bb, const char *why)
+{
+    if (fdatasync(bb->fd) < 0 && errno != EINVAL)
+        why = "error";
+    close(bb->fd);
+    bb->fd = -1;
+    bb->stats.bytes += bb->bytes;
+    fprintf(stderr, "Black box: %s %s, %llu bytes\n", bb->name, why, (long long unsigned) bb->bytes);
+}
+
+// Write the frames of the ring which aren't in the file yet
+static void bbWrite(struct blackbox *bb)
+{
+    struct bbheader *h;
+    uint64_t pos = bb->written;
+    size_t n;
+
+    bb->written = bb->head;
+    for (;;) {
+        pos = bbSkip(bb, pos);
+        h = (pos != bb->head) ? (struct bbheader *) (bb->ring + pos % bb->size) : NULL;
+
+        if (!h || bb->staged + h->len > BLACKBOX_WRITE) {
+            for (n = 0; n < bb->staged; ) {
+                ssize_t w = write(bb->fd, bb->stage + n, bb->staged - n);
+                if (w < 0 && errno == EINTR)
+                    continue;
+                if (w <= 0) {
+                    fprintf(stderr, "Error. Write error in file %s: %s\n", bb->name, strerror(errno));
+                    bb->staged = 0;
+                    bbStop(bb, "cut short");
+                    return;
+                }
+                n += w;
+            }
+            bb->bytes += bb->staged;
+            bb->staged = 0;
+        }
+        if (!h)
+            return;
+
+        memcpy(bb->stage + bb->staged, h + 1, h->len);
+        bb->staged += h->len;
+        pos += bbRecordSize(h->len);
+    }
+}
+
+// Let the oldest frame go, once it is in the file of a recording
+static void bbDrop(struct blackbox *bb)
+{
+    struct bbheader *h = (struct bbheader *) (bb->ring + bb->tail % bb->size);
+
+    if (bb->fd != -1 && bb->written <= bb->tail)
+        bbWrite(bb);
+    bb->tail = bbSkip(bb, bb->tail + bbRecordSize(h->len));
+}
+
+// Recording for a trigger at the real time of real_ms, ms on the receiver
+// clock
+static void bbStart(struct blackbox *bb, uint64_t real_ms, uint64_t ms, const char *reason, uint32_t addr)
+{
+    struct bbheader *h = (struct bbheader *) (bb->ring + bb->tail % bb->size);
+    uint64_t first = (ms > h->ms && real_ms > ms - h->ms) ? real_ms - (ms - h->ms) : real_ms;
+    time_t t = (time_t) (real_ms / 1000);
+    struct tm tm;
+    char date[32];
+
+    // Named after the event, with the time of the first frame like the
+    // logs of flightdata.sh
+    gmtime_r(&t, &tm);
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", &tm);
+    snprintf(bb->name, sizeof(bb->name), "%s/blackbox-%s-%s-%06X--%llu.%09llu--.log", bb->dir, date, reason,
+             addr & 0xffffff, (long long unsigned) (first / 1000), (long long unsigned) (first % 1000) * 1000000ULL);
+
+    bb->fd = open(bb->name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (bb->fd < 0) {
+        fprintf(stderr, "Error. Unable to open for write file %s: %s\n", bb->name, strerror(errno));
+        return;
+    }
+    fprintf(stderr, "Black box: %s from %06X, recording to %s\n", reason, addr & 0xffffff, bb->name);
+
+    bb->written = bb->tail;
+    bb->bytes = 0;
+    bb->stats.files++;
+    bbWrite(bb);
+}
+
+// What in the message fires a trigger, NULL if nothing
+static const char *bbTrigger(struct blackbox *bb, struct modesMessage *mm)
+{
+    if ((bb->triggers & BLACKBOX_SIGNAL) && bb->signals != blackbox_signals) {
+        bb->signals = blackbox_signals;
+        return "signal";
+    }
+    if ((bb->triggers & BLACKBOX_SQUAWK) && mm->squawk_valid) {
+        if (mm->squawk == 0x7500)
+            return "7500";
+        if (mm->squawk == 0x7600)
+            return "7600";
+        if (mm->squawk == 0x7700)
+            return "7700";
+    }
+    if ((bb->triggers & BLACKBOX_ACAS) && mm->acas_ra)
+        return "acas";
+    if ((bb->triggers & BLACKBOX_ALERT) && mm->alert_valid && mm->alert)
+        return "alert";
+    if ((bb->triggers & BLACKBOX_SPI) && mm->spi_valid && mm->spi)
+        return "spi";
+    return NULL;
+}
+
+struct blackbox *blackboxOpen(const char *dir, uint64_t before_ms, uint64_t after_ms, size_t size, int triggers)
+{
+    struct blackbox *bb = calloc(1, sizeof(*bb));
+    struct stat st;
+
+    if (stat(dir, &st) < 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "Error. Black box directory %s not found\n", dir);
+        exit(1);
+    }
+
+    bb->dir = strdup(dir);
+    bb->before_ms = before_ms;
+    bb->after_ms = after_ms;
+    bb->triggers = triggers;
+    bb->size = size & ~(size_t) 7;
+    bb->ring = malloc(bb->size);
+    bb->stage = malloc(BLACKBOX_WRITE);
+    bb->fd = -1;
+    pthread_mutex_init(&bb->lock, NULL);
+    if (!bb->ring || !bb->stage || bb->size < BLACKBOX_WRITE) {
+        fprintf(stderr, "Error. Unable to allocate a black box of %zu bytes\n", size);
+        exit(1);
+    }
+
+    if (triggers & BLACKBOX_SIGNAL) {
+        bb->signals = blackbox_signals;
+        signal(SIGUSR1, blackboxSignal);
+    }
+    return bb;
+}
+
+void blackboxFrame(struct blackbox *bb, char *frame, int len)
+{
+    size_t rec = bbRecordSize(len), need, off;
+    struct bbheader *h;
+    uint64_t ms;
+
+    pthread_mutex_lock(&bb->lock);
+    ms = bbClock(bb, frameTimestamp(frame), 1);
+
+    // Forget what is older than the window, then make room
+    while (bb->tail != bb->head &&
+           ((struct bbheader *) (bb->ring + bb->tail % bb->size))->ms + bb->before_ms < ms)
+        bbDrop(bb);
+
+    // A frame which doesn't fit before the end of the ring goes to its start
+    off = bb->head % bb->size;
+    need = (bb->size - off < rec) ? bb->size - off + rec : rec;
+    while (bb->tail != bb->head && bb->head + need - bb->tail > bb->size) {
+        if (bb->fd == -1)
+            bb->stats.overwritten++;
+        bbDrop(bb);
+    }
+    if (need != rec) {
+        int empty = (bb->tail == bb->head);
+
+        if (bb->size - off >= sizeof(struct bbheader))
+            ((struct bbheader *) (bb->ring + off))->len = BLACKBOX_PAD;
+        bb->head += bb->size - off;
+        if (empty)
+            bb->tail = bb->head;
+        off = 0;
+    }
+
+    h = (struct bbheader *) (bb->ring + off);
+    h->ms = ms;
+    h->len = len;
+    memcpy(h + 1, frame, len);
+    bb->head += rec;
+
+    if (bb->fd != -1 && bb->head - bb->written >= BLACKBOX_WRITE)
+        bbWrite(bb);
+    pthread_mutex_unlock(&bb->lock);
+}
+
+// The recording ends once the decoded messages are past its time: the
+// reader is ahead of them, and a trigger still on its way makes it longer
+void blackboxMessage(struct blackbox *bb, struct modesMessage *mm)
+{
+    uint64_t real_ms = (uint64_t) mm->sysTimestampMsg.tv_sec * 1000 + mm->sysTimestampMsg.tv_nsec / 1000000;
+    const char *reason = bbTrigger(bb, mm);
+    uint64_t ms;
+
+    pthread_mutex_lock(&bb->lock);
+    ms = (Modes.mlat_decoder == MLAT_NONE) ? real_ms : bbClock(bb, mm->timestampMsg, 0);
+
+    if (bb->fd != -1 && ms > bb->until_ms) {
+        bbWrite(bb);
+        if (bb->fd != -1)
+            bbStop(bb, "recorded");
+    }
+
+    if (reason) {
+        bb->stats.triggers++;
+        if (bb->fd == -1)
+            bbStart(bb, real_ms, ms, reason, strcmp(reason, "signal") ? mm->addr : 0);
+        if (bb->until_ms < ms + bb->after_ms)
+            bb->until_ms = ms + bb->after_ms;
+    }
+    pthread_mutex_unlock(&bb->lock);
+}
+
+void blackboxFlush(struct blackbox *bb)
+{
+    pthread_mutex_lock(&bb->lock);
+    if (bb->fd != -1)
+        bbWrite(bb);
+    pthread_mutex_unlock(&bb->lock);
+}
+
+// At the end of the input, or on SIGINT/SIGTERM/SIGHUP: the frames of a
+// recording under way so far still go to its file
+void blackboxClose(struct blackbox *bb, struct blackboxstats *stats)
+{
+    if (bb->fd != -1) {
+        bbWrite(bb);
+        if (bb->fd != -1)
+            bbStop(bb, Modes.exit ? "stopped early" : "recorded");
+    }
+
+    *stats = bb->stats;
+    pthread_mutex_destroy(&bb->lock);
+    free(bb->stage);
+    free(bb->ring);
+    free(bb->dir);
+    free(bb);
+}
+
+int blackboxTriggers(const char *list)
+{
+    static const struct {
+        const char *name;
+        int         trigger;
+    } names[] = {
+        { "squawk", BLACKBOX_SQUAWK },
+        { "alert",  BLACKBOX_ALERT },
+        { "spi",    BLACKBOX_SPI },
+        { "acas",   BLACKBOX_ACAS },
+        { "signal", BLACKBOX_SIGNAL },
+        { "all",    BLACKBOX_ALL },
+        { NULL,     0 }
+    };
+    int triggers = 0, j;
+    size_t len;
+
+    while (*list) {
+        len = strcspn(list, ",");
+        for (j = 0; names[j].name; j++) {
+            if (strlen(names[j].name) == len && !strncmp(list, names[j].name, len))
+                break;
+        }
+        if (!names[j].name)
+            return -1;
+        triggers |= names[j].trigger;
+        list += len;
+        if (*list)
+            list++;
+    }
+    return triggers;
+}
+
+void blackboxPrintStats(FILE *f, const char *dir, struct blackboxstats *s)
+{
+    fprintf(f, "Black box %s: %llu messages fired a trigger, %llu recordings (%llu bytes)",
+           dir, (long long unsigned) s->triggers, (long long unsigned) s->files, (long long unsigned) s->bytes);
+    if (s->overwritten)
+        fprintf(f, ", %llu frames overwritten before their time, --blackbox-size is too small",
+               (long long unsigned) s->overwritten);
+    fprintf(f, "\n");
+}
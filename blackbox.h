@@ -0,0 +1,77 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// blackbox.h: in-memory recorder of the last minutes, written on events
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BLACKBOX_H_INCLUDED
+#define BLACKBOX_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Defaults of --blackbox-before, --blackbox-after (minutes) and
+ * --blackbox-size (MiB) */
+#define BLACKBOX_BEFORE_MIN   10
+#define BLACKBOX_AFTER_MIN    5
+#define BLACKBOX_SIZE_MB      64
+
+/* Frames collected before a write to the file of an event */
+#define BLACKBOX_WRITE        (256*1024)
+
+/* Events which write the recording, for --blackbox-triggers */
+#define BLACKBOX_SQUAWK       1     // Squawk 7500, 7600 or 7700
+#define BLACKBOX_ALERT        2     // Alert flag of the flight status
+#define BLACKBOX_SPI          4     // Special position identification (ident)
+#define BLACKBOX_ACAS         8     // ACAS resolution advisory
+#define BLACKBOX_SIGNAL       16    // SIGUSR1
+#define BLACKBOX_ALL          31
+
+struct blackbox;
+struct modesMessage;
+
+/* Counters of a recorder, left once it is closed */
+struct blackboxstats {
+    uint64_t triggers;      // Events seen, those during a recording too
+    uint64_t files;         // Recordings written
+    uint64_t bytes;
+    uint64_t overwritten;   // Frames lost from the ring before their time was up
+};
+
+// Keep the frames of the last before_ms in a ring of size bytes, and write
+// them with those of the following after_ms to a new file of the directory
+// when one of the triggers fires
+struct blackbox *blackboxOpen(const char *dir, uint64_t before_ms, uint64_t after_ms, size_t size, int triggers);
+
+// Record a frame (escaped BEAST) as it is read, before decoding
+void blackboxFrame(struct blackbox *bb, char *frame, int len);
+
+// Look at a decoded message for the triggers, end the recording once past
+// its time
+void blackboxMessage(struct blackbox *bb, struct modesMessage *mm);
+
+// Write what is waiting for the file of a recording (end of available input)
+void blackboxFlush(struct blackbox *bb);
+
+// Complete the recording under way, if any, and free everything
+void blackboxClose(struct blackbox *bb, struct blackboxstats *stats);
+
+// Triggers from "squawk,alert,spi,acas,signal" or "all", -1 if unknown
+int  blackboxTriggers(const char *list);
+
+void blackboxPrintStats(FILE *f, const char *dir, struct blackboxstats *stats);
+
+#endif // BLACKBOX_H_INCLUDED
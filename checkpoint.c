@@ -0,0 +1,184 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// checkpoint.c: persisted processing state for incremental runs
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+//
+// A checkpoint file is a header followed by the ICAO filter tables and the
+// tracked aircraft. Everything is in native byte order and structures are
+// written raw, so the header records their sizes and a checkpoint from a
+// different build is refused rather than misread.
+//
+struct checkpointHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t aircraft_size;           // sizeof(struct aircraft)
+    uint32_t message_size;            // sizeof(struct modesMessage)
+    uint32_t mlat_decoder;
+
+    uint64_t input_dev;               // Identity of the input file
+    uint64_t input_ino;
+    uint64_t input_offset;            // First byte not processed yet
+
+    uint64_t msg_processed;
+    uint64_t msg_extracted;
+    uint64_t err_not_known_ICAO;
+    uint64_t err_bad_crc;
+
+    uint64_t firsttimestampMsg;
+    uint64_t previoustimestampMsg;
+
+    // Time base, moved by the sync records of --record, and the clock
+    // rate of --mlat-drift
+    uint64_t basetimestampMsg;
+    int64_t  base_sec;
+    int64_t  base_nsec;
+    uint64_t clock_rate;
+};
+
+static void checkpointFillHeader(struct checkpointHeader *h)
+{
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    h->version = CHECKPOINT_VERSION;
+    h->aircraft_size = sizeof(struct aircraft);
+    h->message_size = sizeof(struct modesMessage);
+    h->mlat_decoder = Modes.mlat_decoder;
+}
+
+void checkpointLoad(void)
+{
+    struct checkpointHeader h, expect;
+    FILE *f;
+
+    if (Modes.inputs[0].stream) {
+        fprintf(stderr, "Error. --checkpoint needs a regular input file, not a pipe\n");
+        exit(1);
+    }
+
+    f = fopen(Modes.filename_checkpoint, "rb");
+    if (f == NULL) {
+        if (errno == ENOENT)
+            return; // first run
+        fprintf(stderr, "Error. Unable to open checkpoint file %s: %s\n", Modes.filename_checkpoint, strerror(errno));
+        exit(1);
+    }
+
+    checkpointFillHeader(&expect);
+    if (fread(&h, sizeof(h), 1, f) != 1 ||
+        memcmp(h.magic, expect.magic, sizeof(h.magic)) ||
+        h.version != expect.version ||
+        h.aircraft_size != expect.aircraft_size ||
+        h.message_size != expect.message_size) {
+        fprintf(stderr, "Error. Checkpoint file %s is damaged or was written by another build\n", Modes.filename_checkpoint);
+        exit(1);
+    }
+
+    if (h.mlat_decoder != expect.mlat_decoder) {
+        fprintf(stderr, "Error. Checkpoint file %s was written with another --mlat-time setting\n", Modes.filename_checkpoint);
+        exit(1);
+    }
+
+    if (icaoFilterLoadState(f) < 0 || trackLoadState(f) < 0) {
+        fprintf(stderr, "Error. Checkpoint file %s is truncated\n", Modes.filename_checkpoint);
+        exit(1);
+    }
+    fclose(f);
+
+    Modes.msg_processed = h.msg_processed;
+    Modes.msg_extracted = h.msg_extracted;
+    Modes.err_not_known_ICAO = (int) h.err_not_known_ICAO;
+    Modes.err_bad_crc = (int) h.err_bad_crc;
+    Modes.inputs[0].clock.first = h.firsttimestampMsg;
+    Modes.previoustimestampMsg = h.previoustimestampMsg;
+    Modes.inputs[0].clock.base_timestamp = h.basetimestampMsg;
+    if (h.base_sec || h.base_nsec) {
+        Modes.inputs[0].clock.base_ns = (uint64_t) h.base_sec * 1000000000ULL + (uint64_t) h.base_nsec;
+        Modes.inputs[0].clock.based = 1;
+        Modes.inputs[0].clock.start = 0;
+    }
+    if (h.clock_rate)
+        Modes.inputs[0].clock.rate = h.clock_rate;
+
+    // Same file, and it did not shrink: carry on where we stopped.
+    // Otherwise the log was rotated, so process the new one from the start.
+    if (h.input_dev == (uint64_t) Modes.inputs[0].dev &&
+        h.input_ino == (uint64_t) Modes.inputs[0].ino &&
+        (Modes.inputs[0].dec || h.input_offset <= Modes.inputs[0].size)) {
+        inputSeek(&Modes.inputs[0], h.input_offset);
+        fprintf(stderr, "Resuming from checkpoint at offset 0x%llX, %llu messages processed before\n",
+                (long long unsigned) h.input_offset, Modes.msg_processed);
+    } else {
+        fprintf(stderr, "Input file changed since checkpoint, reading it from the start\n");
+    }
+}
+
+int checkpointSave(void)
+{
+    struct checkpointHeader h;
+    char *tmpname;
+    FILE *f;
+    int ok;
+
+    checkpointFillHeader(&h);
+    h.input_dev = Modes.inputs[0].dev;
+    h.input_ino = Modes.inputs[0].ino;
+    h.input_offset = inputConsumed(&Modes.inputs[0]);
+    h.msg_processed = Modes.msg_processed;
+    h.msg_extracted = Modes.msg_extracted;
+    h.err_not_known_ICAO = Modes.err_not_known_ICAO;
+    h.err_bad_crc = Modes.err_bad_crc;
+    h.firsttimestampMsg = Modes.inputs[0].clock.first;
+    h.previoustimestampMsg = Modes.previoustimestampMsg;
+    h.basetimestampMsg = Modes.inputs[0].clock.base_timestamp;
+    // A beast start time not turned into a midnight yet is found again
+    if (Modes.inputs[0].clock.based && !Modes.inputs[0].clock.start) {
+        h.base_sec = Modes.inputs[0].clock.base_ns / 1000000000ULL;
+        h.base_nsec = Modes.inputs[0].clock.base_ns % 1000000000ULL;
+    }
+    h.clock_rate = Modes.inputs[0].clock.rate;
+
+    // Write aside and rename, so a crash never leaves a half written checkpoint
+    tmpname = malloc(strlen(Modes.filename_checkpoint) + 5);
+    sprintf(tmpname, "%s.tmp", Modes.filename_checkpoint);
+
+    f = fopen(tmpname, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Error. Unable to open for write checkpoint file %s\n", tmpname);
+        free(tmpname);
+        return -1;
+    }
+
+    ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+         icaoFilterSaveState(f) == 0 &&
+         trackSaveState(f) == 0 &&
+         fflush(f) == 0 &&
+         fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(tmpname, Modes.filename_checkpoint) == -1) {
+        fprintf(stderr, "Error. Unable to write checkpoint file %s: %s\n", Modes.filename_checkpoint, strerror(errno));
+        unlink(tmpname);
+        free(tmpname);
+        return -1;
+    }
+
+    free(tmpname);
+    return 0;
+}
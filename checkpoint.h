@@ -0,0 +1,33 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// checkpoint.h: persisted processing state for incremental runs
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+#define CHECKPOINT_MAGIC   "BBXCKPT"
+#define CHECKPOINT_VERSION 3
+
+// Restore state from Modes.filename_checkpoint if it exists and position
+// the input just after the last processed message.
+void checkpointLoad(void);
+
+// Write the current state to Modes.filename_checkpoint. Returns 0 on success.
+int checkpointSave(void);
+
+#endif // CHECKPOINT_H_INCLUDED
@@ -0,0 +1,297 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// columns.c: columnar binary export of decoded messages
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+//
+// The file is made to be mapped into memory and read a column at a time.
+// All numbers are little-endian, every block starts on 8 bytes.
+//
+// Header:
+//   char[8] "BBXCOLS\0", u32 version, u32 number of columns,
+//   u32 rows per group at most, u32 0, u64 0,
+//   then per column 32 bytes: char[24] name (NUL padded), u8 type
+//   (1 signed, 2 unsigned, 3 IEEE float, 4 characters), u8 width, u16 0, u32 0
+//
+// Row groups, one after the other:
+//   char[4] "BBRG", u32 rows, u64 size of the group with this header,
+//   then per column u64 offset of its validity bitmap and u64 offset of
+//   its values, from the start of the file. The bitmap has bit (row & 7)
+//   of byte (row >> 3) set when the value is valid (as in Arrow), the
+//   values are rows * width bytes, a value that is not valid is 0.
+//
+// Index at the end:
+//   char[4] "BBIX", u32 number of groups, u64 rows in all,
+//   u64 offset of each group, then u64 offset of this index and
+//   char[8] "BBXCOLS\0", so the last 16 bytes of the file lead to it.
+//
+
+#define COL_SIGNED   1
+#define COL_UNSIGNED 2
+#define COL_FLOAT    3
+#define COL_CHARS    4
+
+enum {
+    COL_TIME, COL_TIMESTAMP, COL_ADDR, COL_DF, COL_SIGNAL, COL_ALTITUDE,
+    COL_LAT, COL_LON, COL_SPEED, COL_HEADING, COL_VERT_RATE, COL_SQUAWK,
+    COL_CALLSIGN, COL_COUNT
+};
+
+static const struct {
+    const char *name;
+    uint8_t     type;
+    uint8_t     width;
+} col_defs[COL_COUNT] = {
+    { "time",      COL_SIGNED,   8 },   // message time, ns since 1970
+    { "timestamp", COL_UNSIGNED, 8 },   // receiver clock of the frame
+    { "addr",      COL_UNSIGNED, 4 },   // address, bit 24 set if not ICAO
+    { "df",        COL_UNSIGNED, 1 },
+    { "signal",    COL_FLOAT,    4 },   // signal level, 0 to 1 of full scale power
+    { "altitude",  COL_SIGNED,   4 },   // feet, barometric or GNSS as received
+    { "lat",       COL_FLOAT,    8 },
+    { "lon",       COL_FLOAT,    8 },
+    { "speed",     COL_UNSIGNED, 2 },   // knots
+    { "heading",   COL_UNSIGNED, 2 },   // degrees
+    { "vert_rate", COL_SIGNED,   2 },   // feet per minute
+    { "squawk",    COL_UNSIGNED, 2 },   // the four octal digits as hex, 0x7700
+    { "callsign",  COL_CHARS,    8 },
+};
+
+static const char col_magic[8] = "BBXCOLS";
+
+struct colexport {
+    struct outbuf *o;
+    uint64_t  offset;           // Bytes written so far
+    unsigned  rows;             // in the current group
+    unsigned char *valid[COL_COUNT];
+    unsigned char *data[COL_COUNT];
+
+    uint64_t *groups;           // Offsets of the groups written
+    unsigned  ngroups, size;
+    uint64_t  total;
+};
+
+static void colPut(unsigned char *p, uint64_t v, int width) {
+    int i;
+
+    for (i = 0; i < width; i++, v >>= 8)
+        p[i] = (unsigned char) v;
+}
+
+static void colWrite(struct colexport *c, const void *data, size_t len) {
+    const unsigned char *d = data;
+    size_t n;
+    char *p;
+
+    while (len) {
+        n = len < OUTPUT_MAX_LINE ? len : OUTPUT_MAX_LINE;
+        p = outReserve(c->o, n);
+        memcpy(p, d, n);
+        outCommit(c->o, p + n);
+        d += n;
+        len -= n;
+        c->offset += n;
+    }
+}
+
+static void colWriteValue(struct colexport *c, uint64_t v, int width) {
+    unsigned char b[8];
+
+    colPut(b, v, width);
+    colWrite(c, b, width);
+}
+
+static size_t colAlign(size_t n) {
+    return (n + 7) & ~(size_t) 7;
+}
+
+static void colPad(struct colexport *c) {
+    static const unsigned char zero[8];
+
+    colWrite(c, zero, colAlign(c->offset) - c->offset);
+}
+
+struct colexport *colOpen(struct outbuf *o) {
+    struct colexport *c = calloc(1, sizeof(*c));
+    unsigned char desc[32];
+    int j;
+
+    if (!c) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+    c->o = o;
+    for (j = 0; j < COL_COUNT; j++) {
+        c->valid[j] = calloc(COLUMNS_GROUP_ROWS / 8, 1);
+        c->data[j] = calloc(COLUMNS_GROUP_ROWS, col_defs[j].width);
+        if (!c->valid[j] || !c->data[j]) {
+            fprintf(stderr, "Error. Out of memory\n");
+            exit(1);
+        }
+    }
+
+    colWrite(c, col_magic, sizeof(col_magic));
+    colWriteValue(c, COLUMNS_VERSION, 4);
+    colWriteValue(c, COL_COUNT, 4);
+    colWriteValue(c, COLUMNS_GROUP_ROWS, 4);
+    colWriteValue(c, 0, 4);
+    colWriteValue(c, 0, 8);
+    for (j = 0; j < COL_COUNT; j++) {
+        memset(desc, 0, sizeof(desc));
+        memcpy(desc, col_defs[j].name, strlen(col_defs[j].name));
+        desc[24] = col_defs[j].type;
+        desc[25] = col_defs[j].width;
+        colWrite(c, desc, sizeof(desc));
+    }
+    return c;
+}
+
+static void colWriteGroup(struct colexport *c) {
+    uint64_t start = c->offset, at;
+    size_t vlen = colAlign((c->rows + 7) / 8);
+    size_t dlen;
+    int j;
+
+    if (!c->rows)
+        return;
+
+    if (c->ngroups == c->size) {
+        c->size = c->size ? c->size * 2 : 64;
+        c->groups = realloc(c->groups, c->size * sizeof(*c->groups));
+        if (!c->groups) {
+            fprintf(stderr, "Error. Out of memory\n");
+            exit(1);
+        }
+    }
+    c->groups[c->ngroups++] = start;
+
+    // Header with the offsets of all columns, then the columns
+    at = start + 16 + 16 * COL_COUNT;
+    for (j = 0; j < COL_COUNT; j++)
+        at += vlen + colAlign((size_t) c->rows * col_defs[j].width);
+
+    colWrite(c, "BBRG", 4);
+    colWriteValue(c, c->rows, 4);
+    colWriteValue(c, at - start, 8);
+
+    at = start + 16 + 16 * COL_COUNT;
+    for (j = 0; j < COL_COUNT; j++) {
+        dlen = colAlign((size_t) c->rows * col_defs[j].width);
+        colWriteValue(c, at, 8);
+        colWriteValue(c, at + vlen, 8);
+        at += vlen + dlen;
+    }
+
+    for (j = 0; j < COL_COUNT; j++) {
+        colWrite(c, c->valid[j], (c->rows + 7) / 8);
+        colPad(c);
+        colWrite(c, c->data[j], (size_t) c->rows * col_defs[j].width);
+        colPad(c);
+
+        memset(c->valid[j], 0, COLUMNS_GROUP_ROWS / 8);
+        memset(c->data[j], 0, (size_t) COLUMNS_GROUP_ROWS * col_defs[j].width);
+    }
+
+    c->total += c->rows;
+    c->rows = 0;
+}
+
+static void colSet(struct colexport *c, int col, uint64_t v) {
+    unsigned row = c->rows;
+
+    c->valid[col][row >> 3] |= 1 << (row & 7);
+    colPut(c->data[col] + (size_t) row * col_defs[col].width, v, col_defs[col].width);
+}
+
+static uint64_t colDouble(double d) {
+    uint64_t v;
+
+    memcpy(&v, &d, sizeof(v));
+    return v;
+}
+
+static uint64_t colFloat(float f) {
+    uint32_t v;
+
+    memcpy(&v, &f, sizeof(v));
+    return v;
+}
+
+void colAddMessage(struct colexport *c, struct modesMessage *mm) {
+    unsigned row = c->rows;
+    int altitude;
+
+    colSet(c, COL_TIME, (uint64_t) ((int64_t) mm->sysTimestampMsg.tv_sec * 1000000000 + mm->sysTimestampMsg.tv_nsec));
+    if (mm->timestampMsg && mm->timestampMsg != MAGIC_MLAT_TIMESTAMP)
+        colSet(c, COL_TIMESTAMP, mm->timestampMsg);
+    colSet(c, COL_ADDR, mm->addr);
+    colSet(c, COL_DF, mm->msgtype);
+    colSet(c, COL_SIGNAL, colFloat((float) mm->signalLevel));
+
+    if (mm->altitude_valid) {
+        altitude = mm->altitude;
+        if (mm->altitude_unit == UNIT_METERS)
+            altitude = (int) (altitude / 0.3048);
+        colSet(c, COL_ALTITUDE, (uint64_t) (int64_t) altitude);
+    }
+    if (mm->cpr_decoded) {
+        colSet(c, COL_LAT, colDouble(mm->decoded_lat));
+        colSet(c, COL_LON, colDouble(mm->decoded_lon));
+    }
+    if (mm->speed_valid)
+        colSet(c, COL_SPEED, mm->speed);
+    if (mm->heading_valid)
+        colSet(c, COL_HEADING, mm->heading);
+    if (mm->vert_rate_valid)
+        colSet(c, COL_VERT_RATE, (uint64_t) (int64_t) mm->vert_rate);
+    if (mm->squawk_valid)
+        colSet(c, COL_SQUAWK, mm->squawk);
+    if (mm->callsign_valid) {
+        c->valid[COL_CALLSIGN][row >> 3] |= 1 << (row & 7);
+        memcpy(c->data[COL_CALLSIGN] + (size_t) row * 8, mm->callsign, 8);
+    }
+
+    if (++c->rows == COLUMNS_GROUP_ROWS)
+        colWriteGroup(c);
+}
+
+uint64_t colClose(struct colexport *c) {
+    uint64_t index, total;
+    unsigned j;
+
+    colWriteGroup(c);
+
+    index = c->offset;
+    colWrite(c, "BBIX", 4);
+    colWriteValue(c, c->ngroups, 4);
+    colWriteValue(c, c->total, 8);
+    for (j = 0; j < c->ngroups; j++)
+        colWriteValue(c, c->groups[j], 8);
+    colWriteValue(c, index, 8);
+    colWrite(c, col_magic, sizeof(col_magic));
+
+    total = c->total;
+    for (j = 0; j < COL_COUNT; j++) {
+        free(c->valid[j]);
+        free(c->data[j]);
+    }
+    free(c->groups);
+    free(c);
+    return total;
+}
@@ -0,0 +1,42 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// columns.h: columnar binary export of decoded messages
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef COLUMNS_H_INCLUDED
+#define COLUMNS_H_INCLUDED
+
+#include <stdint.h>
+
+/* Rows collected before a row group is written */
+#define COLUMNS_GROUP_ROWS 65536
+
+/* Version of the file layout, see columns.c */
+#define COLUMNS_VERSION    1
+
+struct outbuf;
+struct modesMessage;
+struct colexport;
+
+// One row per message, written in row groups to the output buffer
+struct colexport *colOpen(struct outbuf *o);
+void colAddMessage(struct colexport *c, struct modesMessage *mm);
+
+// Writes the last row group and the index, returns the number of rows
+uint64_t colClose(struct colexport *c);
+
+#endif // COLUMNS_H_INCLUDED
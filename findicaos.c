@@ -0,0 +1,237 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// findicaos.c: --only-find-icaos over all cores
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+#include <signal.h>
+
+//
+// Finding the addresses of a log needs no tracking and no outputs, only
+// the decoder, so a big log is cut in --jobs parts which are decoded at
+// the same time. Every thread has its own ICAO filter, its own counters
+// and its own table of addresses; the tables are merged at the end.
+//
+// A thread which starts in the middle of the log has not seen the DF11/17
+// messages which came before, so at first it cannot check the CRC of the
+// DF0/4/5/16/20/21 messages of aircraft already there. Those of the first
+// FIND_DEFER_FRAMES frames are put aside, which bounds the memory whatever
+// the size of the log, and checked again at the end against the addresses
+// of all the parts before, as the run over the whole log would have.
+//
+
+struct findworker {
+    int            index;
+    char          *filename;
+    uint64_t       start;       // First frame of the part
+    uint64_t       end;         // First frame of the next part
+    pthread_t      thread;
+
+    struct icaofilter *filter;
+    struct icaodb  db;
+    long long unsigned messages;
+    int            bad_crc;
+    int            not_known_icao;
+
+    char          *deferred;    // Frames to check again, one after the other
+    size_t         deferred_len;
+    size_t         deferred_size;
+};
+
+static void findDefer(struct findworker *w, char *frame, int len)
+{
+    if (w->deferred_len + len > w->deferred_size) {
+        w->deferred_size = w->deferred_size ? 2 * w->deferred_size : FIND_READ;
+        w->deferred = realloc(w->deferred, w->deferred_size);
+        if (!w->deferred) {
+            fprintf(stderr, "Error. Out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(w->deferred + w->deferred_len, frame, len);
+    w->deferred_len += len;
+}
+
+static void *findWorker(void *arg)
+{
+    struct findworker *w = arg;
+    struct modesMessage mm;
+    char frame[MAX_MSG_LEN];
+    char *buf = malloc(FIND_READ);
+    uint64_t base = w->start;       // File offset of buf[0]
+    size_t pos = 0, avail = 0;
+    ssize_t n;
+    int fd, i, len;
+
+    fd = open(w->filename, O_RDONLY);
+    if (fd == -1 || !buf) {
+        fprintf(stderr, "Error. Can't read %s: %s\n", w->filename, strerror(errno));
+        exit(1);
+    }
+
+    icaoFilterUse(w->filter);
+
+    while (!Modes.exit) {
+        while (base + pos < w->end && pos < avail) {
+            len = copyBinMessageSafe(buf + pos, avail - pos, frame);
+            if (len < 0)
+                break;
+            if (len == 0) {
+                pos++;
+                continue;
+            }
+            pos += len;
+            if ((unsigned char) frame[1] == BEAST_SYNC_TYPE)
+                continue;   // sync record of --record
+
+            w->messages++;
+            icaoFilterExpire();
+            i = decodeBinFrame(frame, 0, 0, &mm);
+            if (i > 0)
+                icaoDbAdd(&w->db, &mm);
+            else if (i == -1 && w->index && w->messages <= FIND_DEFER_FRAMES)
+                findDefer(w, frame, len);
+            else if (i == -1)
+                w->not_known_icao++;
+            else if (i == -2)
+                w->bad_crc++;
+        }
+        if (base + pos >= w->end)
+            break;
+
+        // Keep the incomplete tail for the next read
+        avail -= pos;
+        memmove(buf, buf + pos, avail);
+        base += pos;
+        pos = 0;
+
+        n = pread(fd, buf + avail, FIND_READ - avail, base + avail);
+        if (n <= 0)
+            break;
+        avail += n;
+    }
+
+    icaoFilterUse(NULL);
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+// First frame at or after offset. A 0x1A followed by a message type starts
+// a frame unless it is the second half of an escaped 0x1A, which shows as
+// an odd run of 0x1A before it.
+static uint64_t findFrameStart(int fd, uint64_t offset, uint64_t size)
+{
+    unsigned char buf[FIND_SYNC];
+    uint64_t from = offset > 256 ? offset - 256 : 0;
+    ssize_t n = pread(fd, buf, sizeof(buf), from);
+    ssize_t j, k;
+
+    for (j = offset - from; j + 1 < n; j++) {
+        if (buf[j] != 0x1A || buf[j+1] < '1' || buf[j+1] > '3')
+            continue;
+        for (k = j; k > 0 && buf[k-1] == 0x1A; k--)
+            ;
+        if ((j - k) % 2 == 0)
+            return from + j;
+    }
+    return n < (ssize_t) sizeof(buf) ? size : from + n;
+}
+
+int findIcaosParallel(void)
+{
+    struct beastinput *in = &Modes.inputs[0];
+    struct findworker *workers;
+    struct icaofilter *seen;
+    struct modesMessage mm;
+    sigset_t old;
+    char frame[MAX_MSG_LEN];
+    int jobs = Modes.batch_jobs ? Modes.batch_jobs : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int fd, j, i;
+    size_t pos;
+
+    // The times of --mlat-time follow the log from its start (midnights,
+    // sync records, clock drift), which a part in the middle can't do
+    if (Modes.ninputs != 1 || in->stream || in->format != INPUT_PLAIN || Modes.follow ||
+        Modes.filename_checkpoint || Modes.max_messages || Modes.batch || Modes.mlat_decoder != MLAT_NONE)
+        return 0;
+
+    if ((uint64_t) jobs > in->size / FIND_CHUNK_MIN)
+        jobs = in->size / FIND_CHUNK_MIN;
+    if (jobs < 2)
+        return 0;
+
+    fd = open(in->filename, O_RDONLY);
+    if (fd == -1)
+        return 0;
+
+    workers = calloc(jobs, sizeof(*workers));
+    for (j = 0; j < jobs; j++) {
+        workers[j].index = j;
+        workers[j].filename = in->filename;
+        workers[j].start = j ? findFrameStart(fd, in->size / jobs * j, in->size) : 0;
+        workers[j].filter = icaoFilterNew();
+        if (j)
+            workers[j-1].end = workers[j].start;
+    }
+    workers[jobs-1].end = in->size;
+    close(fd);
+
+    signalsBlock(&old);
+    for (j = 0; j < jobs; j++) {
+        if (pthread_create(&workers[j].thread, NULL, findWorker, &workers[j])) {
+            fprintf(stderr, "Error. Can't start a thread: %s\n", strerror(errno));
+            exit(1);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    for (j = 0; j < jobs; j++)
+        pthread_join(workers[j].thread, NULL);
+
+    // Frames put aside, against the addresses of all the parts before
+    seen = icaoFilterNew();
+    for (j = 1; j < jobs; j++) {
+        struct findworker *w = &workers[j];
+
+        icaoFilterMerge(seen, workers[j-1].filter);
+        icaoFilterUse(seen);
+        for (pos = 0; pos < w->deferred_len; pos += i) {
+            i = copyBinMessageSafe(w->deferred + pos, w->deferred_len - pos, frame);
+            if (decodeBinFrame(frame, 0, 0, &mm) > 0)
+                icaoDbAdd(&w->db, &mm);
+            else
+                w->not_known_icao++;
+        }
+        icaoFilterUse(NULL);
+    }
+    free(seen);
+
+    for (j = 0; j < jobs; j++) {
+        struct findworker *w = &workers[j];
+
+        icaoMergeDB(&w->db);
+        Modes.msg_processed += w->messages;
+        Modes.err_bad_crc += w->bad_crc;
+        Modes.err_not_known_ICAO += w->not_known_icao;
+        icaoDbFree(&w->db);
+        free(w->filter);
+        free(w->deferred);
+    }
+    free(workers);
+    return 1;
+}
@@ -0,0 +1,42 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// findicaos.h: --only-find-icaos over all cores
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FINDICAOS_H_INCLUDED
+#define FINDICAOS_H_INCLUDED
+
+/* Smallest part of the log given to a thread */
+#define FIND_CHUNK_MIN  (1024*1024)
+
+/* Bytes read by a thread at once */
+#define FIND_READ       (1024*1024)
+
+/* Frames at the start of a part whose address may only be known by the
+   parts before it, a minute or two of a busy receiver */
+#define FIND_DEFER_FRAMES (256*1024)
+
+/* Bytes looked at to find the first frame after a split point */
+#define FIND_SYNC       (64*1024)
+
+// Look for the addresses of a single plain log with --jobs threads, each
+// taking a part of the file. Returns 0 without doing anything when the log
+// does not lend itself to it (stream, compressed, small, --follow...), the
+// caller then decodes it as usual.
+int findIcaosParallel(void);
+
+#endif // FINDICAOS_H_INCLUDED
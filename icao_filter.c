@@ -19,26 +19,29 @@
 
 #include "beastblackbox.h"
 
-// hash table size, must be a power of two:
-#define ICAO_FILTER_SIZE 16384
-
-// Millis between filter expiry flips:
-#define MODES_ICAO_FILTER_TTL 5000
-
-#define ICAO_PER_LINE 10
-
 // Open-addressed hash table with linear probing.
 // We store each address twice to handle Data/Parity
 // which need to match on a partial address (top 16 bits only).
 
 // Maintain two tables and switch between them to age out entries.
+struct icaofilter {
+    uint32_t  a[ICAO_FILTER_SIZE];
+    uint32_t  b[ICAO_FILTER_SIZE];
+    uint32_t *active;
+    uint64_t  next_flip;     // Time of the next expiry flip
+};
 
-static uint32_t icao_filter_a[ICAO_FILTER_SIZE];
-static uint32_t icao_filter_b[ICAO_FILTER_SIZE];
-static uint32_t *icao_filter_active;
+// The filter of the decoder, unless a thread has one of its own
+static struct icaofilter icao_global;
+static _Thread_local struct icaofilter *icao_local;
 
-// Table for unique ICAO's
-static uint32_t icao_db[ICAO_FILTER_SIZE];
+// Addresses found, for --only-find-icaos
+static struct icaodb icao_db;
+
+static inline struct icaofilter *icaoFilter(void)
+{
+    return icao_local ? icao_local : &icao_global;
+}
 
 static uint32_t icaoHash(uint32_t a)
 {
@@ -66,14 +69,32 @@ static uint32_t icaoHash(uint32_t a)
 
 void icaoFilterInit()
 {
-    memset(icao_filter_a, 0, sizeof(icao_filter_a));
-    memset(icao_filter_b, 0, sizeof(icao_filter_b));
-    memset(icao_db, 0, sizeof(icao_db));
-    icao_filter_active = icao_filter_a;
+    memset(&icao_global, 0, sizeof(icao_global));
+    icao_global.active = icao_global.a;
+    icaoDbFree(&icao_db);
+}
+
+struct icaofilter *icaoFilterNew()
+{
+    struct icaofilter *f = calloc(1, sizeof(*f));
+
+    if (!f) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+    f->active = f->a;
+    return f;
+}
+
+void icaoFilterUse(struct icaofilter *f)
+{
+    icao_local = f;
 }
 
 void icaoFilterAdd(uint32_t addr)
 {
+    struct icaofilter *f = icaoFilter();
+    uint32_t *icao_filter_active = f->active;
     uint32_t h, h0;
     h0 = h = icaoHash(addr);
     while (icao_filter_active[h] && icao_filter_active[h] != addr) {
@@ -101,6 +122,8 @@ void icaoFilterAdd(uint32_t addr)
 
 int icaoFilterTest(uint32_t addr)
 {
+    struct icaofilter *f = icaoFilter();
+    uint32_t *icao_filter_a = f->a, *icao_filter_b = f->b;
     uint32_t h, h0;
 
     h0 = h = icaoHash(addr);
@@ -126,6 +149,8 @@ int icaoFilterTest(uint32_t addr)
 
 uint32_t icaoFilterTestFuzzy(uint32_t partial)
 {
+    struct icaofilter *f = icaoFilter();
+    uint32_t *icao_filter_a = f->a, *icao_filter_b = f->b;
     uint32_t h, h0;
 
     partial &= 0x00ffff;
@@ -153,67 +178,237 @@ uint32_t icaoFilterTestFuzzy(uint32_t partial)
 // call this periodically:
 void icaoFilterExpire()
 {
-    static uint64_t next_flip = 0;
+    struct icaofilter *f = icaoFilter();
     uint64_t now = mstime();
 
-    if (now >= next_flip) {
-        if (icao_filter_active == icao_filter_a) {
-            memset(icao_filter_b, 0, sizeof(icao_filter_b));
-            icao_filter_active = icao_filter_b;
+    if (now >= f->next_flip) {
+        if (f->active == f->a) {
+            memset(f->b, 0, sizeof(f->b));
+            f->active = f->b;
         } else {
-            memset(icao_filter_a, 0, sizeof(icao_filter_a));
-            icao_filter_active = icao_filter_a;
+            memset(f->a, 0, sizeof(f->a));
+            f->active = f->a;
         }
-        next_flip = now + MODES_ICAO_FILTER_TTL;
+        f->next_flip = now + MODES_ICAO_FILTER_TTL;
+    }
+}
+
+void icaoFilterMerge(struct icaofilter *into, struct icaofilter *from)
+{
+    struct icaofilter *saved = icao_local;
+    uint32_t i;
+
+    icao_local = into;
+    for (i = 0; i < ICAO_FILTER_SIZE; i++) {
+        if (from->a[i])
+            icaoFilterAdd(from->a[i]);
+        if (from->b[i])
+            icaoFilterAdd(from->b[i]);
     }
+    icao_local = saved;
 }
 
-static void icaoAddtoDB_collision(uint32_t addr, uint32_t hash, int depth) {
+// Checkpoint support: dump both tables (active one first) and the ICAO DB
+int icaoFilterSaveState(FILE *f)
+{
+    uint32_t *inactive = (icao_global.active == icao_global.a) ? icao_global.b : icao_global.a;
+    uint32_t i;
 
-	uint32_t h;
-	h = icaoHash(hash);
+    if (fwrite(icao_global.active, sizeof(icao_global.a), 1, f) != 1 ||
+        fwrite(inactive, sizeof(icao_global.a), 1, f) != 1 ||
+        fwrite(&icao_db.used, sizeof(icao_db.used), 1, f) != 1)
+        return -1;
 
-	if(!icao_db[h]) {
-	icao_db[h] = addr;
-	} else
-		if (icao_db[h] != addr) {
-		if (depth > 5) {printf("ERROR: hash table is full. Some ICAOs are lost!\n"); return;}
-		icaoAddtoDB_collision(addr, h, depth + 1); // Hash collision.
-		}
+    for (i = 0; i < icao_db.size; i++) {
+        if (icao_db.entries[i].messages && fwrite(&icao_db.entries[i], sizeof(struct icaodbentry), 1, f) != 1)
+            return -1;
+    }
+    return 0;
+}
 
+int icaoFilterLoadState(FILE *f)
+{
+    struct icaodbentry e;
+    uint32_t count, i;
+
+    if (fread(icao_global.a, sizeof(icao_global.a), 1, f) != 1 ||
+        fread(icao_global.b, sizeof(icao_global.b), 1, f) != 1 ||
+        fread(&count, sizeof(count), 1, f) != 1)
+        return -1;
+
+    for (i = 0; i < count; i++) {
+        if (fread(&e, sizeof(e), 1, f) != 1)
+            return -1;
+        icaoDbAddEntry(&icao_db, &e);
+    }
+
+    // The saved active table becomes "a"; give it a full TTL before it ages out "b"
+    icao_global.active = icao_global.a;
+    icao_global.next_flip = mstime() + MODES_ICAO_FILTER_TTL;
+    return 0;
 }
 
-void icaoAddtoDB(uint32_t addr) {
+//
+// The addresses found by --only-find-icaos. A bit per possible ICAO address
+// tells which were seen, so they come out sorted and none is ever lost; the
+// number of messages and the times are kept in a hash table which grows as
+// needed, together with the non-ICAO addresses.
+//
 
-	uint32_t h;
-	h = icaoHash(addr);
+static uint32_t icaoDbHash(uint32_t addr)
+{
+    addr ^= addr >> 16;
+    addr *= 0x45d9f3bU;
+    addr ^= addr >> 16;
+    return addr;
+}
 
-	if(!icao_db[h]) {
-	icao_db[h] = addr;
-	} else
-		if (icao_db[h] != addr) {
-		icaoAddtoDB_collision(addr, h, 0); // Hash collision. Try to add with double hash
-		}
+static struct icaodbentry *icaoDbFind(struct icaodb *db, uint32_t addr)
+{
+    uint32_t h = icaoDbHash(addr) & (db->size - 1);
 
+    while (db->entries[h].messages && db->entries[h].addr != addr)
+        h = (h + 1) & (db->size - 1);
+    return &db->entries[h];
+}
+
+static void icaoDbGrow(struct icaodb *db)
+{
+    struct icaodbentry *old = db->entries;
+    uint32_t i, size = db->size;
+
+    db->size = size ? size * 2 : ICAO_DB_INITIAL;
+    db->entries = calloc(db->size, sizeof(struct icaodbentry));
+    if (!db->icao)
+        db->icao = calloc(ICAO_DB_BITS / 64, sizeof(uint64_t));
+    if (!db->entries || !db->icao) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+
+    for (i = 0; i < size; i++) {
+        if (old[i].messages)
+            *icaoDbFind(db, old[i].addr) = old[i];
+    }
+    free(old);
+}
+
+void icaoDbAddEntry(struct icaodb *db, const struct icaodbentry *from)
+{
+    struct icaodbentry *e;
+
+    if (2 * (db->used + 1) > db->size)
+        icaoDbGrow(db);
+
+    e = icaoDbFind(db, from->addr);
+    if (!e->messages) {
+        *e = *from;
+        db->used++;
+        if (!(from->addr & MODES_NON_ICAO_ADDRESS))
+            db->icao[from->addr >> 6] |= (uint64_t) 1 << (from->addr & 63);
+        return;
+    }
+
+    e->messages += from->messages;
+    if (from->first < e->first)
+        e->first = from->first;
+    if (from->last > e->last)
+        e->last = from->last;
+}
+
+void icaoDbAdd(struct icaodb *db, struct modesMessage *mm)
+{
+    struct icaodbentry e;
+
+    e.addr = mm->addr;
+    e.messages = 1;
+    e.first = e.last = (uint64_t) mm->sysTimestampMsg.tv_sec * 1000 + mm->sysTimestampMsg.tv_nsec / 1000000;
+    icaoDbAddEntry(db, &e);
+}
+
+void icaoDbMerge(struct icaodb *db, struct icaodb *from)
+{
+    uint32_t i;
+
+    for (i = 0; i < from->size; i++) {
+        if (from->entries[i].messages)
+            icaoDbAddEntry(db, &from->entries[i]);
+    }
+}
+
+void icaoDbFree(struct icaodb *db)
+{
+    free(db->entries);
+    free(db->icao);
+    memset(db, 0, sizeof(*db));
+}
+
+void icaoAddtoDB(struct modesMessage *mm) {
+	icaoDbAdd(&icao_db, mm);
+}
+
+void icaoMergeDB(struct icaodb *from) {
+	icaoDbMerge(&icao_db, from);
+}
+
+static void icaoPrintTime(uint64_t ms) {
+	time_t t = (time_t) (ms / 1000);
+	struct tm tm;
+
+	if (Modes.useLocaltime) localtime_r(&t, &tm); else gmtime_r(&t, &tm);
+	printf("  %04d-%02d-%02d %02d:%02d:%02d.%03u", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+		tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned) (ms % 1000));
+}
+
+// Times are only known with a time decoder (--mlat-time)
+static void icaoPrintEntry(const struct icaodbentry *e) {
+	printf("%s%06X %10u", (e->addr & MODES_NON_ICAO_ADDRESS) ? "~" : " ", e->addr & 0xFFFFFF, e->messages);
+	if (Modes.mlat_decoder != MLAT_NONE) {
+		icaoPrintTime(e->first);
+		icaoPrintTime(e->last);
+	}
+	printf("\n");
+}
+
+static int icaoCompareEntries(const void *a, const void *b) {
+	uint32_t x = ((const struct icaodbentry *) a)->addr, y = ((const struct icaodbentry *) b)->addr;
+	return (x > y) - (x < y);
 }
 
 void icaoPrintDB() {
-	uint32_t i = 0;
-	uint32_t row = 0;
-	uint32_t total = 0;
+	struct icaodbentry *other = NULL;
+	uint32_t i, total = 0, nother = 0;
+	int b;
 
 	printf("File contains the following ICAOs:\n\n");
+	printf(" ICAO     Messages%s\n", (Modes.mlat_decoder != MLAT_NONE) ? "  First seen               Last seen" : "");
 
-	for(i=0; i<ICAO_FILTER_SIZE; i++) {
+	for (i = 0; icao_db.icao && i < ICAO_DB_BITS / 64; i++) {
+		uint64_t w = icao_db.icao[i];
 
-	if(icao_db[i]) {
-		printf("%06X ",icao_db[i]);
-		row++;
-		total++;
+		for (b = 0; w; b++, w >>= 1) {
+			if (w & 1) {
+				icaoPrintEntry(icaoDbFind(&icao_db, i * 64 + b));
+				total++;
+			}
+		}
 	}
 
-	if(row==ICAO_PER_LINE) {row=0; printf("\n");}
+	// Non-ICAO addresses (marked with ~) after the others
+	if (icao_db.used > total) {
+		other = malloc((icao_db.used - total) * sizeof(*other));
+		for (i = 0; i < icao_db.size; i++) {
+			if (icao_db.entries[i].messages && (icao_db.entries[i].addr & MODES_NON_ICAO_ADDRESS))
+				other[nother++] = icao_db.entries[i];
+		}
+		qsort(other, nother, sizeof(*other), icaoCompareEntries);
+		for (i = 0; i < nother; i++)
+			icaoPrintEntry(&other[i]);
+		free(other);
 	}
-	printf("\n\n");
-	printf("Total found %d unique ICAOs\n", total);
+
+	printf("\n");
+	printf("Total found %u unique ICAOs", total);
+	if (nother) printf(" and %u non-ICAO addresses", nother);
+	printf("\n");
 }
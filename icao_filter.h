@@ -20,9 +20,31 @@
 #ifndef DUMP1090_ICAO_FILTER_H
 #define DUMP1090_ICAO_FILTER_H
 
+#include <stdint.h>
+#include <stdio.h>
+
+// hash table size, must be a power of two:
+#define ICAO_FILTER_SIZE 16384
+
+// Millis between filter expiry flips:
+#define MODES_ICAO_FILTER_TTL 5000
+
+// Bits of the set of ICAO addresses found, and first size of the table
+// of their counts
+#define ICAO_DB_BITS    (1 << 24)
+#define ICAO_DB_INITIAL 1024
+
+struct icaofilter;
+struct modesMessage;
+
 // Call once:
 void icaoFilterInit();
 
+// A thread may use a filter of its own instead of the decoder's one
+// (NULL to go back to it)
+struct icaofilter *icaoFilterNew();
+void icaoFilterUse(struct icaofilter *f);
+
 // Add an address to the filter
 void icaoFilterAdd(uint32_t addr);
 
@@ -38,8 +60,38 @@ uint32_t icaoFilterTestFuzzy(uint32_t partial);
 // old entries.
 void icaoFilterExpire();
 
-// Added for beastblackbox
-void icaoAddtoDB(uint32_t addr);
+// Add the addresses of a filter to another one
+void icaoFilterMerge(struct icaofilter *into, struct icaofilter *from);
+
+// Addresses found by --only-find-icaos, with their number of messages and
+// the times (millis) of the first and the last one
+struct icaodbentry {
+    uint32_t addr;
+    uint32_t messages;
+    uint64_t first;
+    uint64_t last;
+};
+
+struct icaodb {
+    uint64_t *icao;                 // ICAO_DB_BITS, set for each ICAO address found
+    struct icaodbentry *entries;    // Open addressing, every address found
+    uint32_t size;
+    uint32_t used;
+};
+
+void icaoDbAdd(struct icaodb *db, struct modesMessage *mm);
+void icaoDbAddEntry(struct icaodb *db, const struct icaodbentry *e);
+void icaoDbMerge(struct icaodb *db, struct icaodb *from);
+void icaoDbFree(struct icaodb *db);
+
+// The addresses found by the decoder, sorted on output
+void icaoAddtoDB(struct modesMessage *mm);
+void icaoMergeDB(struct icaodb *from);
 void icaoPrintDB();
 
+// Save/restore filter tables and the ICAO DB (--checkpoint).
+// Return 0 on success, -1 on I/O error.
+int icaoFilterSaveState(FILE *f);
+int icaoFilterLoadState(FILE *f);
+
 #endif
@@ -0,0 +1,1058 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// input.c: BEAST input sources
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+//
+// ============================= Follow mode ===============================
+//
+// With --follow we behave like "tail -f": at end of file we wait for more
+// data instead of stopping. inotify tells us when the file changes; if it is
+// not available we simply poll every INPUT_FOLLOW_POLL_MS. Either way the
+// file is re-examined on every wakeup to catch rotation and truncation.
+//
+
+static void inputWatch(struct beastinput *in)
+{
+#ifdef __linux__
+    if (in->notify_fd == -1)
+        return;
+
+    // The watch on a rotated file goes away with it, ignore errors here
+    if (in->notify_wd >= 0)
+        inotify_rm_watch(in->notify_fd, in->notify_wd);
+
+    in->notify_wd = inotify_add_watch(in->notify_fd, in->filename,
+                                      IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+#else
+    MODES_NOTUSED(in);
+#endif
+}
+
+static void inputWait(struct beastinput *in)
+{
+    struct timespec interval;
+
+    // Nothing more to read for now, so push out what was decoded so far
+    pipelineFlush();
+
+#ifdef __linux__
+    if (in->notify_fd != -1) {
+        struct pollfd pfd;
+        char events[4096];
+
+        pfd.fd = in->notify_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        // Time out anyway: a rotated file is replaced without an event on our watch
+        if (poll(&pfd, 1, INPUT_FOLLOW_POLL_MS) > 0) {
+            while (read(in->notify_fd, events, sizeof(events)) > 0)
+                ;
+        }
+        return;
+    }
+#endif
+
+    interval.tv_sec = 0;
+    interval.tv_nsec = INPUT_FOLLOW_POLL_MS * 1000000L;
+    nanosleep(&interval, NULL);
+}
+
+// Called at EOF in follow mode. Returns 1 if there may be new data to read
+// right away (the file was truncated or replaced), 0 if we should wait.
+static int inputCheckRotation(struct beastinput *in)
+{
+    struct stat st;
+    int fd;
+
+    if (fstat(in->fd, &st) == 0) {
+        if ((uint64_t) st.st_size < in->offset) {
+            // Truncated in place (logrotate copytruncate, or "> file")
+            fprintf(stderr, "\nFile %s truncated, reading from the start\n", in->filename);
+            lseek(in->fd, 0, SEEK_SET);
+            in->offset = 0;
+            in->size = st.st_size;
+            in->reset = 1;
+            return 1;
+        }
+        in->size = st.st_size;
+    }
+
+    if (stat(in->filename, &st) == -1 || (st.st_dev == in->dev && st.st_ino == in->ino))
+        return 0;
+
+    // Someone moved our file away and created a new one with the same name.
+    // We only get here at EOF, so the old one is fully drained.
+    fd = open(in->filename, O_RDONLY);
+    if (fd == -1)
+        return 0;
+
+    fprintf(stderr, "\nFile %s rotated, reading the new file\n", in->filename);
+    close(in->fd);
+    in->fd = fd;
+    in->dev = st.st_dev;
+    in->ino = st.st_ino;
+    in->offset = 0;
+    in->size = st.st_size;
+    in->reset = 1;
+    inputWatch(in);
+    return 1;
+}
+
+//
+// ========================== Compressed input =============================
+//
+// Compressed logs are decompressed by a separate thread into a small pool
+// of large chunks. Filled chunks are passed to the reader through one ring
+// and come back empty through another, so nothing is allocated per chunk
+// and decompression overlaps with decoding.
+//
+
+struct inputChunk {
+    size_t len;
+    char   data[INPUT_CHUNK_SIZE];
+};
+
+struct inputDecompressor {
+    struct beastinput *in;
+    pthread_t          thread;
+    struct ring        filled;      // decompressor -> reader
+    struct ring        empty;       // reader -> decompressor
+    struct inputChunk *chunks;
+    struct inputChunk *current;     // chunk being consumed by the reader
+    size_t             pos;         // read position in current
+    atomic_ullong      raw_bytes;   // compressed bytes consumed so far
+    const char        *error;       // set by the thread before it finishes
+    char               inbuf[65536];
+};
+
+static const char *inputFormatName(input_format_t format)
+{
+    switch (format) {
+    case INPUT_GZIP: return "gzip";
+    case INPUT_XZ:   return "xz";
+    case INPUT_ZSTD: return "zstd";
+    case INPUT_PACKED: return "packed";
+    default:         return "plain";
+    }
+}
+
+static input_format_t inputDetectFormat(const unsigned char *p, size_t len)
+{
+    if (len >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+        return INPUT_GZIP;
+    if (len >= 6 && !memcmp(p, "\xfd" "7zXZ\0", 6))
+        return INPUT_XZ;
+    if (len >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd)
+        return INPUT_ZSTD;
+    if (len >= 8 && !memcmp(p, PACK_MAGIC, 8))
+        return INPUT_PACKED;
+    return INPUT_PLAIN;
+}
+
+int inputIsLog(const char *filename)
+{
+    unsigned char p[8];
+    ssize_t n;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+    n = read(fd, p, sizeof(p));
+    close(fd);
+    if (n < 2)
+        return 0;
+    if (inputDetectFormat(p, n) != INPUT_PLAIN)
+        return 1;
+    return p[0] == 0x1a && ((p[1] >= '1' && p[1] <= '4') || p[1] == BEAST_SYNC_TYPE);
+}
+
+// Bytes straight from the file, the magic bytes peeked at open come first
+static ssize_t inputRawRead(struct beastinput *in, char *buf, size_t len)
+{
+    ssize_t n, done = 0;
+
+    if (in->magic_pos < in->magic_len) {
+        done = in->magic_len - in->magic_pos;
+        if ((size_t) done > len)
+            done = len;
+        memcpy(buf, in->magic + in->magic_pos, done);
+        in->magic_pos += done;
+        buf += done;
+        len -= done;
+        if (!len)
+            return done;
+    }
+
+    do {
+        n = read(in->fd, buf, len);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0)
+        return done ? done : n;
+    return done + n;
+}
+
+// Hand back a filled chunk; returns -1 if the reader went away
+static int decPushChunk(struct inputDecompressor *dec, struct inputChunk **chunk)
+{
+    if ((*chunk)->len == 0)
+        return 0;
+    if (ringPush(&dec->filled, *chunk) < 0)
+        return -1;
+    *chunk = ringPop(&dec->empty);
+    if (*chunk == NULL)
+        return -1;
+    (*chunk)->len = 0;
+    return 0;
+}
+
+static ssize_t decFeed(struct inputDecompressor *dec)
+{
+    ssize_t n = inputRawRead(dec->in, dec->inbuf, sizeof(dec->inbuf));
+
+    if (n > 0)
+        atomic_fetch_add(&dec->raw_bytes, n);
+    if (n < 0)
+        dec->error = "read error";
+    return n;
+}
+
+// Exactly len bytes, returns 0 at a clean end of input and -1 on error
+static int decFeedFull(struct inputDecompressor *dec, unsigned char *buf, size_t len)
+{
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < len) {
+        n = inputRawRead(dec->in, (char *) buf + done, len - done);
+        if (n < 0) {
+            dec->error = "read error";
+            return -1;
+        }
+        if (n == 0) {
+            if (done)
+                dec->error = "packed archive is truncated";
+            return done ? -1 : 0;
+        }
+        atomic_fetch_add(&dec->raw_bytes, n);
+        done += n;
+    }
+    return 1;
+}
+
+// Archive made by --pack: blocks expand straight into the chunks
+static void decPacked(struct inputDecompressor *dec, struct inputChunk *chunk)
+{
+    unsigned char header[PACK_BLOCK_HEADER];
+    unsigned char *data = malloc(PACK_BLOCK_DATA + PACK_BLOCK_DATA / 8);
+    struct packblock b;
+    ssize_t n;
+
+    if (decFeedFull(dec, header, PACK_FILE_HEADER) <= 0 || header[8] != PACK_VERSION) {
+        dec->error = "unknown packed archive version";
+        goto done;
+    }
+
+    while (decFeedFull(dec, header, PACK_BLOCK_HEADER) > 0) {
+        if (!packParseBlock(header, &b)) {
+            dec->error = "packed archive is damaged";
+            break;
+        }
+        if (decFeedFull(dec, data, b.stored) <= 0) {
+            if (!dec->error)
+                dec->error = "packed archive is truncated";
+            break;
+        }
+        if (chunk->len + b.beast > INPUT_CHUNK_SIZE && decPushChunk(dec, &chunk) < 0)
+            break;
+        n = packDecodeBlock(&b, data, (unsigned char *) chunk->data + chunk->len);
+        if (n < 0) {
+            dec->error = "packed archive is damaged";
+            break;
+        }
+        chunk->len += n;
+    }
+
+done:
+    if (chunk)
+        decPushChunk(dec, &chunk);
+    free(data);
+}
+
+#ifdef HAVE_ZLIB
+static void decGzip(struct inputDecompressor *dec, struct inputChunk *chunk)
+{
+    z_stream zs;
+    int ret = Z_OK;
+
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 32) != Z_OK) { // 32: accept gzip and zlib headers
+        dec->error = "zlib init failed";
+        return;
+    }
+
+    for (;;) {
+        if (zs.avail_in == 0) {
+            ssize_t n = decFeed(dec);
+            if (n <= 0) {
+                if (n == 0 && ret != Z_STREAM_END)
+                    dec->error = "compressed stream is truncated";
+                break;
+            }
+            zs.next_in = (Bytef *) dec->inbuf;
+            zs.avail_in = n;
+        }
+
+        // Several gzip members may be concatenated (gzip a >> b)
+        if (ret == Z_STREAM_END)
+            inflateReset(&zs);
+
+        zs.next_out = (Bytef *) chunk->data + chunk->len;
+        zs.avail_out = INPUT_CHUNK_SIZE - chunk->len;
+        ret = inflate(&zs, Z_NO_FLUSH);
+        chunk->len = INPUT_CHUNK_SIZE - zs.avail_out;
+
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            dec->error = zs.msg ? zs.msg : "gzip data error";
+            break;
+        }
+        if (chunk->len == INPUT_CHUNK_SIZE && decPushChunk(dec, &chunk) < 0)
+            break;
+    }
+
+    if (chunk)
+        decPushChunk(dec, &chunk);
+    inflateEnd(&zs);
+}
+#endif
+
+#ifdef HAVE_LZMA
+static void decXz(struct inputDecompressor *dec, struct inputChunk *chunk)
+{
+    lzma_stream xs = LZMA_STREAM_INIT;
+    lzma_ret ret;
+    lzma_action action = LZMA_RUN;
+
+    if (lzma_stream_decoder(&xs, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+        dec->error = "lzma init failed";
+        return;
+    }
+
+    for (;;) {
+        if (xs.avail_in == 0 && action == LZMA_RUN) {
+            ssize_t n = decFeed(dec);
+            if (n < 0)
+                break;
+            if (n == 0)
+                action = LZMA_FINISH;
+            xs.next_in = (const uint8_t *) dec->inbuf;
+            xs.avail_in = n;
+        }
+
+        xs.next_out = (uint8_t *) chunk->data + chunk->len;
+        xs.avail_out = INPUT_CHUNK_SIZE - chunk->len;
+        ret = lzma_code(&xs, action);
+        chunk->len = INPUT_CHUNK_SIZE - xs.avail_out;
+
+        if (ret == LZMA_STREAM_END)
+            break;
+        if (ret != LZMA_OK) {
+            dec->error = (ret == LZMA_BUF_ERROR) ? "compressed stream is truncated" : "xz data error";
+            break;
+        }
+        if (chunk->len == INPUT_CHUNK_SIZE && decPushChunk(dec, &chunk) < 0)
+            break;
+    }
+
+    if (chunk)
+        decPushChunk(dec, &chunk);
+    lzma_end(&xs);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static void decZstd(struct inputDecompressor *dec, struct inputChunk *chunk)
+{
+    ZSTD_DStream *zs = ZSTD_createDStream();
+    ZSTD_inBuffer zin = { dec->inbuf, 0, 0 };
+    size_t ret = 0;
+
+    if (zs == NULL) {
+        dec->error = "zstd init failed";
+        return;
+    }
+
+    for (;;) {
+        ZSTD_outBuffer zout;
+
+        if (zin.pos == zin.size) {
+            ssize_t n = decFeed(dec);
+            if (n <= 0) {
+                if (n == 0 && ret != 0)
+                    dec->error = "compressed stream is truncated";
+                break;
+            }
+            zin.size = n;
+            zin.pos = 0;
+        }
+
+        zout.dst = chunk->data;
+        zout.size = INPUT_CHUNK_SIZE;
+        zout.pos = chunk->len;
+        ret = ZSTD_decompressStream(zs, &zout, &zin);
+        chunk->len = zout.pos;
+
+        if (ZSTD_isError(ret)) {
+            dec->error = ZSTD_getErrorName(ret);
+            break;
+        }
+        if (chunk->len == INPUT_CHUNK_SIZE && decPushChunk(dec, &chunk) < 0)
+            break;
+    }
+
+    if (chunk)
+        decPushChunk(dec, &chunk);
+    ZSTD_freeDStream(zs);
+}
+#endif
+
+static void *inputDecompressThread(void *arg)
+{
+    struct inputDecompressor *dec = arg;
+    struct inputChunk *chunk = ringPop(&dec->empty);
+
+    chunk->len = 0;
+    switch (dec->in->format) {
+#ifdef HAVE_ZLIB
+    case INPUT_GZIP: decGzip(dec, chunk); break;
+#endif
+#ifdef HAVE_LZMA
+    case INPUT_XZ:   decXz(dec, chunk); break;
+#endif
+#ifdef HAVE_ZSTD
+    case INPUT_ZSTD: decZstd(dec, chunk); break;
+#endif
+    case INPUT_PACKED: decPacked(dec, chunk); break;
+    default: break;
+    }
+
+    // End of stream for the reader
+    ringClose(&dec->filled);
+    return NULL;
+}
+
+static int inputFormatSupported(input_format_t format)
+{
+    switch (format) {
+#ifdef HAVE_ZLIB
+    case INPUT_GZIP: return 1;
+#endif
+#ifdef HAVE_LZMA
+    case INPUT_XZ:   return 1;
+#endif
+#ifdef HAVE_ZSTD
+    case INPUT_ZSTD: return 1;
+#endif
+    case INPUT_PACKED: return 1;
+    default:         return 0;
+    }
+}
+
+static void inputStartDecompressor(struct beastinput *in)
+{
+    struct inputDecompressor *dec;
+    sigset_t old;
+    int i;
+
+    if (!inputFormatSupported(in->format)) {
+        fprintf(stderr, "Error. BEAST file %s is %s compressed, but this build has no %s support\n",
+                in->filename, inputFormatName(in->format), inputFormatName(in->format));
+        exit(1);
+    }
+
+    if (Modes.follow && !in->stream) {
+        fprintf(stderr, "Error. --follow does not work with compressed BEAST file %s\n", in->filename);
+        exit(1);
+    }
+
+    dec = calloc(1, sizeof(*dec));
+    dec->in = in;
+    dec->chunks = malloc(INPUT_CHUNKS * sizeof(struct inputChunk));
+    if (!dec->chunks) {
+        fprintf(stderr, "Error. Out of memory for decompression buffers\n");
+        exit(1);
+    }
+    atomic_init(&dec->raw_bytes, 0);
+    ringInit(&dec->filled, INPUT_CHUNKS);
+    ringInit(&dec->empty, INPUT_CHUNKS);
+    for (i = 0; i < INPUT_CHUNKS; ++i)
+        ringPush(&dec->empty, &dec->chunks[i]);
+
+    in->dec = dec;
+    signalsBlock(&old);
+    if (pthread_create(&dec->thread, NULL, inputDecompressThread, dec)) {
+        fprintf(stderr, "Error. Unable to start decompressor thread\n");
+        exit(1);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+static ssize_t inputReadDecompressed(struct beastinput *in, char *buf, size_t len)
+{
+    struct inputDecompressor *dec = in->dec;
+    size_t n;
+
+    while (dec->current == NULL || dec->pos == dec->current->len) {
+        if (dec->current)
+            ringPush(&dec->empty, dec->current);
+        dec->pos = 0;
+        dec->current = ringPop(&dec->filled);
+        if (dec->current == NULL) {
+            if (dec->error) {
+                fprintf(stderr, "\nWarning. BEAST file %s: %s\n", in->filename, dec->error);
+                dec->error = NULL;
+            }
+            return 0;
+        }
+    }
+
+    n = dec->current->len - dec->pos;
+    if (n > len)
+        n = len;
+    memcpy(buf, dec->current->data + dec->pos, n);
+    dec->pos += n;
+    in->offset += n;
+    return n;
+}
+
+static void inputStopDecompressor(struct beastinput *in)
+{
+    struct inputDecompressor *dec = in->dec;
+
+    // Unblock the thread wherever it waits, then wait for it
+    ringClose(&dec->empty);
+    ringClose(&dec->filled);
+    pthread_join(dec->thread, NULL);
+
+    ringDestroy(&dec->filled);
+    ringDestroy(&dec->empty);
+    free(dec->chunks);
+    free(dec);
+    in->dec = NULL;
+}
+
+int inputProgress(struct beastinput *in)
+{
+    struct stat st;
+
+    if (Modes.follow || !in->size)
+        return -1;
+    if (in->dec) {
+        if (fstat(in->fd, &st) == -1 || !st.st_size)
+            return -1;
+        return (int) (100 * atomic_load(&in->dec->raw_bytes) / st.st_size);
+    }
+    return (int) (100 * inputConsumed(in) / in->size);
+}
+
+//
+// ================================ Frames =================================
+//
+int copyBinMessageSafe(char *p, int limit, char *out) {
+    int msgLen = 0;
+    int  j = 2;
+    char ch;
+	if (limit < 11) return -1; // Nothing to do
+    ch = *p;
+    if (0x1A == ch) {
+		p++;
+		*out = 0x1A;
+		out++;
+		} else return 0;
+
+	ch = *p;
+    if ((ch == '1')) {
+        msgLen = MODEAC_MSG_BYTES;
+		*out = '1';
+		out++;
+    } else if (ch == '2') {
+        msgLen = MODES_SHORT_MSG_BYTES;
+		*out = '2';
+		out++;
+    } else if (ch == '3') {
+        msgLen = MODES_LONG_MSG_BYTES;
+		*out = '3';
+		out++;
+    } else if ((unsigned char) ch == BEAST_SYNC_TYPE) {
+        msgLen = BEAST_SYNC_BYTES;
+		*out = ch;
+		out++;
+    } else return 0;
+
+
+
+    if (msgLen) {
+	   msgLen += 9;
+	   if (msgLen  > limit)   return -1;
+	   p++;
+        while ((j < msgLen)) {
+
+			if (msgLen > limit)   return -2;
+			*out = ch = *p++;
+			j++;
+			out++;
+			if (0x1A == ch) { msgLen++; *out = ch = *p++; out++; j++; }
+        }
+    }
+	if (msgLen > limit) return -3;
+	out -= msgLen;
+    return msgLen;
+}
+
+int inputNextFrame(struct beastinput *in, char *frame)
+{
+    ssize_t n;
+    int i;
+
+    for (;;) {
+        while (in->pos < in->avail) {
+            i = copyBinMessageSafe(in->buffer + in->pos, in->avail - in->pos, frame);
+            if (i > 0) {
+                in->pos += i;
+                if (in->record)
+                    recordFrame(in->record, frame, i);
+                return i;
+            }
+            if (i < 0)
+                break;      // incomplete frame, read more
+            in->pos++;      // not a frame start, resync
+        }
+
+        // Keep the incomplete tail for the next read
+        in->avail -= in->pos;
+        if (in->avail)
+            memmove(in->buffer, in->buffer + in->pos, in->avail);
+        in->pos = 0;
+
+        n = inputRead(in, in->buffer + in->avail, INPUT_READAHEAD - in->avail);
+        if (n <= 0)
+            return 0;
+
+        // The stream started over (follow mode), a partial frame is useless now
+        if (in->reset) {
+            memmove(in->buffer, in->buffer + in->avail, n);
+            in->avail = 0;
+            in->reset = 0;
+        }
+        in->avail += n;
+    }
+}
+
+uint64_t inputConsumed(struct beastinput *in)
+{
+    return in->offset - (in->avail - in->pos);
+}
+
+//
+// ============================= Network input =============================
+//
+// --connect reads the BEAST stream of a feeder (dump1090, readsb, a radar
+// box) straight from its TCP port, as `nc host 30005 > log` did. The socket
+// is non-blocking with a big receive buffer, so a busy moment of the
+// decoder doesn't hold up the feeder. A lost connection is made again after
+// a delay which doubles after every failed attempt, from
+// INPUT_RECONNECT_MIN_MS up to INPUT_RECONNECT_MAX_MS; the partial frame is
+// dropped then, like with a rotated file.
+//
+
+// Sleep for ms milliseconds, or until we are asked to exit
+static void inputSleep(unsigned ms)
+{
+    struct timespec interval;
+
+    while (ms && !Modes.exit) {
+        unsigned step = (ms < INPUT_FOLLOW_POLL_MS) ? ms : INPUT_FOLLOW_POLL_MS;
+
+        interval.tv_sec = 0;
+        interval.tv_nsec = step * 1000000L;
+        nanosleep(&interval, NULL);
+        ms -= step;
+    }
+}
+
+// One attempt to connect. Returns the socket, -1 on failure.
+static int inputTryConnect(struct beastinput *in)
+{
+    struct addrinfo hints, *res, *ai;
+    char *host = strdup(in->filename);
+    char *port = strrchr(host, ':');
+    int fd = -1, err, size = INPUT_SOCKET_SIZE, one = 1;
+
+    *port++ = '\0';
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    err = getaddrinfo(host, port, &hints, &res);
+    if (err) {
+        fprintf(stderr, "Error. Unable to resolve %s: %s\n", in->filename, gai_strerror(err));
+        free(host);
+        return -1;
+    }
+
+    for (ai = res; ai && fd == -1; ai = ai->ai_next) {
+        struct pollfd pfd;
+        socklen_t len = sizeof(err);
+
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd == -1)
+            continue;
+
+        // The buffer has to be asked for before connecting to get a big window
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        err = 0;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+            err = errno;
+            if (errno == EINPROGRESS) {
+                pfd.fd = fd;
+                pfd.events = POLLOUT;
+                if (poll(&pfd, 1, INPUT_CONNECT_TIMEOUT_MS) != 1)
+                    err = ETIMEDOUT;
+                else if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1)
+                    err = errno;
+            }
+        }
+        if (err) {
+            fprintf(stderr, "Error. Unable to connect to %s: %s\n", in->filename, strerror(err));
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+    free(host);
+    return fd;
+}
+
+// Connect, trying again until it works or we are asked to exit
+static void inputReconnect(struct beastinput *in)
+{
+    if (in->fd != -1) {
+        close(in->fd);
+        in->fd = -1;
+        in->reset = 1;
+    }
+
+    while (!Modes.exit) {
+        in->fd = inputTryConnect(in);
+        if (in->fd != -1) {
+            fprintf(stderr, "Connected to %s\n", in->filename);
+            return;
+        }
+
+        // Meanwhile the outputs have what was received so far
+        if (in->offset)
+            pipelineFlush();
+        fprintf(stderr, "Connecting again to %s in %u s\n", in->filename, in->backoff_ms / 1000);
+        inputSleep(in->backoff_ms);
+        in->backoff_ms *= 2;
+        if (in->backoff_ms > INPUT_RECONNECT_MAX_MS)
+            in->backoff_ms = INPUT_RECONNECT_MAX_MS;
+    }
+}
+
+static ssize_t inputReadNet(struct beastinput *in, char *buf, size_t len)
+{
+    struct pollfd pfd;
+    ssize_t n;
+
+    while (!Modes.exit) {
+        if (in->fd == -1)
+            inputReconnect(in);
+        if (in->fd == -1)
+            break;
+
+        n = read(in->fd, buf, len);
+        if (n > 0) {
+            in->backoff_ms = INPUT_RECONNECT_MIN_MS;
+            return n;
+        }
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            // Show what we have before waiting for the feeder
+            pipelineFlush();
+            if (in->record)
+                recordIdle(in->record);
+            pfd.fd = in->fd;
+            pfd.events = POLLIN;
+            poll(&pfd, 1, INPUT_FOLLOW_POLL_MS);
+            continue;
+        }
+
+        if (n == 0)
+            fprintf(stderr, "Connection to %s closed by the feeder\n", in->filename);
+        else
+            fprintf(stderr, "Connection to %s lost: %s\n", in->filename, strerror(errno));
+        close(in->fd);
+        in->fd = -1;
+        in->reset = 1;
+        if (in->record)
+            recordPause(in->record);
+    }
+    return 0;
+}
+
+void inputConnect(struct beastinput *in, const char *hostport, int index)
+{
+    const char *colon = strrchr(hostport, ':');
+
+    if (!colon || colon == hostport || !colon[1]) {
+        fprintf(stderr, "Error. --connect needs <host>:<port>, got '%s'\n", hostport);
+        exit(1);
+    }
+
+    memset(in, 0, sizeof(*in));
+    in->filename = strdup(hostport);
+    in->index = index;
+    in->buffer = malloc(INPUT_READAHEAD + MAX_MSG_LEN);
+    in->fd = -1;
+    in->notify_fd = -1;
+    in->notify_wd = -1;
+    in->archive_fd = -1;
+    in->net = 1;
+    in->stream = 1;
+    in->format = INPUT_PLAIN;
+    in->backoff_ms = INPUT_RECONNECT_MIN_MS;
+
+    inputReconnect(in);
+}
+
+void inputArchive(struct beastinput *in, const char *filename)
+{
+    in->archive_fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (in->archive_fd == -1) {
+        fprintf(stderr, "Error. Unable to open for write file %s: %s\n", filename, strerror(errno));
+        exit(1);
+    }
+}
+
+// A copy of what was read, written as it comes so that nothing is lost
+// if we are killed
+static void inputArchiveWrite(struct beastinput *in, const char *buf, ssize_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(in->archive_fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            fprintf(stderr, "Error. Write error in archive of %s: %s\n", in->filename, strerror(errno));
+            close(in->archive_fd);
+            in->archive_fd = -1;
+            return;
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+//
+// ============================= Input sources =============================
+//
+void inputOpen(struct beastinput *in, const char *filename, int index)
+{
+    struct stat st;
+
+    memset(in, 0, sizeof(*in));
+    in->filename = strdup(filename);
+    in->index = index;
+    in->buffer = malloc(INPUT_READAHEAD + MAX_MSG_LEN);
+    in->notify_fd = -1;
+    in->notify_wd = -1;
+    in->archive_fd = -1;
+
+    if (!strcmp(filename, "-"))
+        in->fd = dup(STDIN_FILENO);
+    else
+        in->fd = open(filename, O_RDONLY);  // blocks on a named pipe until a writer shows up
+    if (in->fd == -1) {
+        fprintf(stderr, "Error. Unable to open for read BEAST file %s\n", filename);
+        exit(1);
+    }
+
+    if (fstat(in->fd, &st) == 0) {
+        in->dev = st.st_dev;
+        in->ino = st.st_ino;
+        if (S_ISREG(st.st_mode))
+            in->size = st.st_size;
+        else
+            in->stream = 1;
+
+#ifdef F_SETPIPE_SZ
+        // A bigger pipe lets the writer (nc, zstdcat, an aggregator) run ahead
+        // of us instead of blocking every 64 KiB. Not fatal if refused.
+        if (S_ISFIFO(st.st_mode) && fcntl(in->fd, F_GETPIPE_SZ) < INPUT_PIPE_SIZE)
+            fcntl(in->fd, F_SETPIPE_SZ, INPUT_PIPE_SIZE);
+#endif
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (!in->stream)
+        posix_fadvise(in->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    if (Modes.follow && !in->stream) {
+#ifdef __linux__
+        in->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+        inputWatch(in);
+    }
+
+    // Peek at the first bytes to see whether the log is compressed.
+    // They are handed out again by the first reads.
+    if (!Modes.follow || in->size || in->stream) {
+        ssize_t n;
+        do {
+            n = read(in->fd, in->magic, sizeof(in->magic));
+        } while (n < 0 && errno == EINTR);
+        in->magic_len = (n > 0) ? n : 0;
+        in->format = inputDetectFormat(in->magic, in->magic_len);
+        if (in->format != INPUT_PLAIN)
+            inputStartDecompressor(in);
+    }
+}
+
+static ssize_t inputReadData(struct beastinput *in, char *buf, size_t len);
+
+ssize_t inputRead(struct beastinput *in, char *buf, size_t len)
+{
+    ssize_t n = inputReadData(in, buf, len);
+
+    if (n > 0 && in->archive_fd != -1)
+        inputArchiveWrite(in, buf, n);
+    return n;
+}
+
+static ssize_t inputReadData(struct beastinput *in, char *buf, size_t len)
+{
+    ssize_t n;
+
+    if (in->dec)
+        return Modes.exit ? 0 : inputReadDecompressed(in, buf, len);
+
+    if (in->net) {
+        n = inputReadNet(in, buf, len);
+        in->offset += n;
+        return n;
+    }
+
+    while (!Modes.exit) {
+        // Live stream: show what we have before waiting for the sender
+        if (in->stream && in->magic_pos == in->magic_len) {
+            struct pollfd pfd;
+
+            pfd.fd = in->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 0) == 0)
+                pipelineFlush();
+        }
+
+        n = inputRawRead(in, buf, len);
+        if (n > 0) {
+            in->offset += n;
+            return n;
+        }
+
+        if (n < 0) {
+            fprintf(stderr, "Error. Unable to read BEAST file %s: %s\n", in->filename, strerror(errno));
+            return 0;
+        }
+
+        if (!Modes.follow || in->stream)
+            return 0;
+
+        if (!inputCheckRotation(in))
+            inputWait(in);
+    }
+
+    return 0;
+}
+
+void inputSeek(struct beastinput *in, uint64_t offset)
+{
+    if (in->dec) {
+        char skip[BUF_SIZE];
+
+        while (in->offset < offset) {
+            size_t want = (offset - in->offset < sizeof(skip)) ? offset - in->offset : sizeof(skip);
+            if (inputReadDecompressed(in, skip, want) <= 0) {
+                fprintf(stderr, "Error. BEAST file %s is shorter than the checkpoint offset\n", in->filename);
+                exit(1);
+            }
+        }
+        in->pos = in->avail = 0;
+        return;
+    }
+
+    if (lseek(in->fd, (off_t) offset, SEEK_SET) == (off_t) -1) {
+        fprintf(stderr, "Error. Unable to seek in BEAST file %s\n", in->filename);
+        exit(1);
+    }
+    in->magic_pos = in->magic_len;
+    in->offset = offset;
+    in->pos = in->avail = 0;
+}
+
+void inputClose(struct beastinput *in)
+{
+    if (in->dec)
+        inputStopDecompressor(in);
+    if (in->fd != -1)
+        close(in->fd);
+    if (in->notify_fd != -1)
+        close(in->notify_fd);
+    if (in->archive_fd != -1)
+        close(in->archive_fd);
+    in->fd = in->notify_fd = in->archive_fd = -1;
+    free(in->filename);
+    free(in->buffer);
+    in->filename = in->buffer = NULL;
+}
@@ -0,0 +1,156 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// input.h: BEAST input sources prototypes
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INPUT_H_INCLUDED
+#define INPUT_H_INCLUDED
+
+#include <sys/types.h>
+#include <stdint.h>
+
+/* How often to look at a followed file when inotify is not available (or
+ * as a safety net when it is), in milliseconds */
+#define INPUT_FOLLOW_POLL_MS 250
+
+/* Pipe buffer size asked for when the input is a pipe (Linux) */
+#define INPUT_PIPE_SIZE  (1024*1024)
+
+/* Socket receive buffer asked for a --connect input */
+#define INPUT_SOCKET_SIZE (4*1024*1024)
+
+/* Delay before connecting again to a feeder, doubled after every failure,
+ * and how long a connection may take, in milliseconds */
+#define INPUT_RECONNECT_MIN_MS   1000
+#define INPUT_RECONNECT_MAX_MS   60000
+#define INPUT_CONNECT_TIMEOUT_MS 5000
+
+/* Bytes read from an input at once */
+#define INPUT_READAHEAD  (64*1024)
+
+/* Size and number of buffers between the decompressor thread and the reader */
+#define INPUT_CHUNK_SIZE (256*1024)
+#define INPUT_CHUNKS     8
+
+/* Input encodings, detected by magic bytes */
+typedef enum {
+    INPUT_PLAIN, INPUT_GZIP, INPUT_XZ, INPUT_ZSTD, INPUT_PACKED
+} input_format_t;
+
+struct inputDecompressor;
+
+// The receiver clock of an input and what it stands for in real time
+// (--mlat-time). Every input has its own: logs of different receivers
+// have unrelated clocks, start times and sync records.
+// --mlat-drift: least squares line through the sync records of an input,
+// (ticks, ns) from the first one, kept as running means and co-moments
+struct mlatdrift {
+	uint64_t n;
+	uint64_t timestamp, ns;  // First sync record, origin of the fit
+	double   mx, my, cxx, cxy;
+	double   ppm;            // Last estimate
+	uint64_t estimates;
+};
+
+struct mlatclock {
+	int      based;          // Real time known: start time, checkpoint or sync record
+	int      start;          // beast: base_ns is a start time, the first message tells its midnight
+	uint64_t base_ns;        // beast: midnight of the day; dump1090: real time of base_timestamp
+	uint64_t base_timestamp; // dump1090: the first message, then the last sync record
+	uint64_t first;          // Timestamp of the first frame, 0 before
+	uint64_t rate;           // dump1090: ns per tick (32.32 fixed point)
+	int64_t  last_second;    // beast: seconds of day of the last message, -1 before
+	uint64_t last_ns;        // Time of the last frame, for those without a timestamp
+	struct mlatdrift drift;  // dump1090: rate estimate from the sync records
+};
+
+/* State of one BEAST input */
+struct beastinput {
+    char     *filename;     // Path, as given by the user
+    int       fd;           // Open descriptor, -1 if closed
+    dev_t     dev;          // Identity of the open file, to detect rotation
+    ino_t     ino;
+    uint64_t  offset;       // Bytes read from the current file
+    uint64_t  size;         // Last known file size (0 if unknown)
+    int       stream;       // Pipe, socket or terminal: no size, no seeking, EOF is final
+    int       reset;        // Set when the stream restarted (rotation/truncation),
+                            // the caller must drop any partial frame it holds
+    int       net;          // --connect: a TCP feeder, connected again when lost
+    unsigned  backoff_ms;   // Wait before the next connection attempt
+    int       archive_fd;   // Copy of the BEAST data read (--archive), -1 if none
+    struct recorder *record; // Logs of the frames with sync records (--record), NULL if none
+    int       notify_fd;    // inotify descriptor in follow mode, -1 if unavailable
+    int       notify_wd;    // inotify watch on the current file
+
+    input_format_t format;  // Plain BEAST, compressed or packed (--pack)
+    unsigned char  magic[8];   // Bytes read to detect the format, not yet returned
+    size_t         magic_len;
+    size_t         magic_pos;
+    struct inputDecompressor *dec; // Decompressor thread, NULL for plain input
+
+    int       index;        // Position in Modes.inputs, tags the decoded messages
+    char     *buffer;       // Read ahead data, frames are cut from here
+    size_t    pos;          // First byte not yet consumed in buffer
+    size_t    avail;        // Bytes in buffer
+
+    // Merging several inputs (see readbeastfile)
+    char      frame[MAX_MSG_LEN]; // Next frame of this input
+    int       frame_len;
+    uint64_t  frame_time;   // Its time (the merge key), from mlatClockTime()
+
+    struct mlatclock clock; // Receiver clock, --mlat-time
+};
+
+// Open the input, exits on error. "-" is the standard input.
+void inputOpen(struct beastinput *in, const char *filename, int index);
+
+// Does the file start like a log: a BEAST frame, or the magic of a
+// compressed or packed one
+int inputIsLog(const char *filename);
+
+// Read from a BEAST feeder at "host:port" (dump1090 port 30005), never
+// giving up: the connection is made again whenever it is lost.
+void inputConnect(struct beastinput *in, const char *hostport, int index);
+
+// Append the data read from the input to the file (--archive)
+void inputArchive(struct beastinput *in, const char *filename);
+
+// Read up to len bytes. Returns 0 at end of input: at EOF normally, or
+// when the program is asked to exit in --follow mode.
+ssize_t inputRead(struct beastinput *in, char *buf, size_t len);
+
+// Copy the next complete BEAST frame (still escaped) to frame, skipping
+// anything that is not a frame. Returns its length, 0 at end of input.
+int inputNextFrame(struct beastinput *in, char *frame);
+
+// Copy the escaped frame at p (at most limit bytes) to out. Returns its
+// length, 0 if p is not a frame start, < 0 if the frame is incomplete.
+int copyBinMessageSafe(char *p, int limit, char *out);
+
+// Bytes of the current file handed out as frames or skipped
+uint64_t inputConsumed(struct beastinput *in);
+
+// Continue reading from the given offset (--checkpoint).
+// Compressed input is decompressed and skipped up to the offset.
+void inputSeek(struct beastinput *in, uint64_t offset);
+
+// Percentage of the input processed so far, -1 if it can't be told
+int inputProgress(struct beastinput *in);
+
+void inputClose(struct beastinput *in);
+
+#endif // INPUT_H_INCLUDED
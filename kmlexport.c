@@ -1,103 +1,852 @@
-// Part of BEAST black box utility, a Mode S message BEAST decoder from file
-//
-// kmlexport.c: routines to write KML format
-//
-// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
-//
-// This file is free software: you may copy, redistribute and/or modify it
-// under the terms of the GNU General Public License as published by the
-// Free Software Foundation, either version 2 of the License, or (at your
-// option) any later version.
-//
-// This file is distributed in the hope that it will be useful, but
-// WITHOUT ANY WARRANTY; without even the implied warranty of
-// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
-// General Public License for more details.
-//
-// You should have received a copy of the GNU General Public License
-// along with this program.  If not, see <http://www.gnu.org/licenses/>.
-
-// This file incorporates work covered by the following copyright and
-// permission notice:
-//
-//   Copyright (C) 2012 by Salvatore Sanfilippo <antirez@gmail.com>
-//
-//   All rights reserved.
-//
-//   Redistribution and use in source and binary forms, with or without
-//   modification, are permitted provided that the following conditions are
-//   met:
-//
-//    *  Redistributions of source code must retain the above copyright
-//       notice, this list of conditions and the following disclaimer.
-//
-//    *  Redistributions in binary form must reproduce the above copyright
-//       notice, this list of conditions and the following disclaimer in the
-//       documentation and/or other materials provided with the distribution.
-//
-//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-//   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-//   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-//   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-//   HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-//   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-//   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-//   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-//   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-//   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-
-#include "kmlexport.h"
-
-const char kml_head[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
-"<kml xmlns=\"http://www.opengis.net/kml/2.2\"> <Document>"
- "<name>KML Flight reconstruction of ICAO %X</name>"
- "<description>Produced by BEAST black box https://github.com/denzen84/beastblackbox/blob/master/README.md</description> <Style id=\"yellowLineGreenPoly\">"
- "<LineStyle>"
- "<color>7fffae1f</color>"
- "<width>4</width>"
- "</LineStyle>"
- "<PolyStyle>"
- "<color>7fb8581b</color>"
- "</PolyStyle>"
- "</Style> <Placemark>"
- "<name>ICAO %X</name>"
- "<description>Flight</description>"
- "<styleUrl>#yellowLineGreenPoly</styleUrl>"
- "<LineString>"
- "<extrude>1</extrude>"
- "<tessellate>1</tessellate>"
- "<altitudeMode>absolute</altitudeMode>"
- "<coordinates>\r\n";
-
- const char kml_end[] = "</coordinates>"
- "</LineString> </Placemark>"
- "</Document> </kml>\r\n";
-
- void writeKMLpreamble(FILE *f, uint32_t icao) {
-	fprintf(f, kml_head, icao, icao);
- }
-
- void writeKMLcoordinates(FILE *f, struct modesMessage *mm) {
-	 int alt = 0;
-	 struct aircraft *a = Modes.aircrafts;
-	 if (mm->msgtype == 17 || mm->msgtype == 18) {
-		if (mm->metype >= 9 && mm->metype <= 18) {
-            // It's what we need
-			// Fields 15 and 16 are the Lat/Lon (if we have it)
-			if (mm->altitude_valid && mm->cpr_decoded) {
-			if (mm->altitude_source == ALTITUDE_BARO) {
-                alt = mm->altitude;
-            } else if (trackDataValid(&a->gnss_delta_valid)) {
-                alt = mm->altitude - a->gnss_delta;
-            } else return;
-
-			fprintf(f, "%1.5f,%1.5f,%.1f\r\n", mm->decoded_lon,mm->decoded_lat,(float) alt*0.3048);
-			}
-		}
-     }
-}
-
-void writeKMLend(FILE *f) {
-    fprintf(f, kml_end);
- }
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// kmlexport.c: routines to write KML format
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// This file incorporates work covered by the following copyright and
+// permission notice:
+//
+//   Copyright (C) 2012 by Salvatore Sanfilippo <antirez@gmail.com>
+//
+//   All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are
+//   met:
+//
+//    *  Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//    *  Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//   HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#define _GNU_SOURCE // fopencookie(), for KMZ output
+
+#include "kmlexport.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+const char kml_head[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+"<kml xmlns=\"http://www.opengis.net/kml/2.2\"> <Document>"
+ "<name>KML Flight reconstruction of ICAO %X</name>"
+ "<description>Produced by BEAST black box https://github.com/denzen84/beastblackbox/blob/master/README.md</description> <Style id=\"yellowLineGreenPoly\">"
+ "<LineStyle>"
+ "<color>7fffae1f</color>"
+ "<width>4</width>"
+ "</LineStyle>"
+ "<PolyStyle>"
+ "<color>7fb8581b</color>"
+ "</PolyStyle>"
+ "</Style> <Placemark>"
+ "<name>ICAO %X</name>"
+ "<description>Flight</description>"
+ "<styleUrl>#yellowLineGreenPoly</styleUrl>"
+ "<LineString>"
+ "<extrude>1</extrude>"
+ "<tessellate>1</tessellate>"
+ "<altitudeMode>absolute</altitudeMode>"
+ "<coordinates>\r\n";
+
+ const char kml_end[] = "</coordinates>"
+ "</LineString> </Placemark>"
+ "</Document> </kml>\r\n";
+
+// Several aircraft in one document: a Placemark per flight
+const char kml_multi_head[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+"<kml xmlns=\"http://www.opengis.net/kml/2.2\"> <Document>"
+ "<name>KML Flight reconstruction</name>"
+ "<description>Produced by BEAST black box https://github.com/denzen84/beastblackbox/blob/master/README.md</description> <Style id=\"yellowLineGreenPoly\">"
+ "<LineStyle>"
+ "<color>7fffae1f</color>"
+ "<width>4</width>"
+ "</LineStyle>"
+ "<PolyStyle>"
+ "<color>7fb8581b</color>"
+ "</PolyStyle>"
+ "</Style>\r\n";
+
+const char kml_multi_end[] = "</Document> </kml>\r\n";
+
+// gx:Track: the same with the Google extensions and the per point data
+const char kml_gx_head[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+"<kml xmlns=\"http://www.opengis.net/kml/2.2\" xmlns:gx=\"http://www.google.com/kml/ext/2.2\"> <Document>"
+ "<name>KML Flight reconstruction</name>"
+ "<description>Produced by BEAST black box https://github.com/denzen84/beastblackbox/blob/master/README.md</description> <Style id=\"yellowLineGreenPoly\">"
+ "<LineStyle>"
+ "<color>7fffae1f</color>"
+ "<width>4</width>"
+ "</LineStyle>"
+ "<PolyStyle>"
+ "<color>7fb8581b</color>"
+ "</PolyStyle>"
+ "</Style> <Schema id=\"flight\">"
+ "<gx:SimpleArrayField name=\"speed\" type=\"int\"><displayName>Speed, kt</displayName></gx:SimpleArrayField>"
+ "<gx:SimpleArrayField name=\"heading\" type=\"int\"><displayName>Heading</displayName></gx:SimpleArrayField>"
+ "</Schema>\r\n";
+
+const char geojson_head[] = "{\"type\":\"FeatureCollection\",\"features\":[";
+const char geojson_end[] = "\r\n]}\r\n";
+
+static void writeKMLpreamble(struct outbuf *o, uint32_t icao) {
+	char *p = outReserve(o, sizeof(kml_head) + 16);
+	p += sprintf(p, kml_head, icao, icao);
+	outCommit(o, p);
+}
+
+static void writeKMLend(struct outbuf *o) {
+	char *p = outReserve(o, sizeof(kml_end));
+	p = fmtStr(p, kml_end);
+	outCommit(o, p);
+}
+
+// Position and altitude (feet) of an airborne position message, 0 if it has none
+static int kmlPosition(struct modesMessage *mm, struct trackpoint *pt) {
+
+	if (mm->msgtype != 17 && mm->msgtype != 18)
+		return 0;
+	if (mm->metype < 9 || mm->metype > 18)
+		return 0;
+	if (!mm->altitude_valid || !mm->cpr_decoded)
+		return 0;
+
+	if (mm->altitude_source == ALTITUDE_BARO) {
+		pt->alt = mm->altitude;
+	} else {
+		// GNSS altitude, converted with the delta known for this aircraft
+		if (!mm->aircraft.gnss_delta_valid)
+			return 0;
+		pt->alt = mm->altitude - mm->aircraft.gnss_delta;
+	}
+
+	pt->lon = mm->decoded_lon;
+	pt->lat = mm->decoded_lat;
+	pt->speed = -1;
+	pt->heading = -1;
+	pt->time = (uint64_t) mm->sysTimestampMsg.tv_sec * 1000 + mm->sysTimestampMsg.tv_nsec / 1000000;
+	return 1;
+}
+
+static void kmlWritePoint(struct outbuf *o, const struct trackpoint *pt) {
+	char *p = outReserve(o, 64);
+
+	p = fmtFixed(p, pt->lon, 5); *p++ = ',';
+	p = fmtFixed(p, pt->lat, 5); *p++ = ',';
+	p = fmtFixed(p, (float) pt->alt*0.3048, 1);
+	*p++ = '\r'; *p++ = '\n';
+	outCommit(o, p);
+}
+
+//
+//=========================================================================
+//
+// A LineString with an ICAO filter gets the points of that aircraft written
+// as they come. Otherwise every aircraft is exported in the same pass:
+// points are kept per flight in growing arrays and a flight is written out
+// as one Placemark (or GeoJSON Feature) when it ends, when nothing was
+// heard from the aircraft for KML_FLIGHT_GAP of message time, or at the
+// end of the input. A flight longer than KML_FLIGHT_POINTS is written in
+// parts so memory stays bounded; gx:Track and GeoJSON need all points of
+// a part together as the times, speeds and headings go in separate lists.
+// Either way the points go through the simplifier first (--simplify).
+//
+
+#define KML_HASH_BITS 12
+#define KML_HASH_SIZE (1 << KML_HASH_BITS)
+
+struct kmlflight {
+	uint32_t addr;
+	char     callsign[9];
+	int      number;        // 1 for the first flight of this aircraft
+	int      speed;         // Last known speed and heading, -1 if none yet
+	int      heading;
+	struct simplifier simp;
+	struct trackpoint *points;  // kept points
+	size_t   npoints, size;
+	struct kmlflight *hash_next;
+	struct kmlflight *prev, *next;  // in order of first point
+};
+
+struct kmlexport {
+	struct outbuf *o;
+	kml_style_t style;
+	double    tolerance;
+	uint32_t  icao;         // The only aircraft, 0 for all of them
+	struct simplifier simp; // of that aircraft
+
+	struct kmlflight *hash[KML_HASH_SIZE];
+	struct kmlflight *first, *last;
+	uint64_t  points;
+	struct kmlflightcount {     // Flights seen per aircraft, for numbering
+		uint32_t addr;
+		int      flights;
+		struct kmlflightcount *next;
+	} *counts[KML_HASH_SIZE];
+
+	uint64_t  features;     // GeoJSON features written, for the commas
+	time_t    date_sec;     // Last time formatted
+	char      date[24];
+
+	uint64_t  points_in, points_out;
+};
+
+static unsigned kmlHash(uint32_t addr) {
+	return (addr * 2654435761U) >> (32 - KML_HASH_BITS);
+}
+
+struct kmlexport *kmlOpen(struct outbuf *o, kml_style_t style, uint32_t icao, double tolerance) {
+	struct kmlexport *k = calloc(1, sizeof(*k));
+	const char *head;
+	char *p;
+
+	if (!k) {
+		fprintf(stderr, "Error. Out of memory\n");
+		exit(1);
+	}
+	k->o = o;
+	k->style = style;
+	k->icao = icao;
+	k->tolerance = tolerance;
+	k->date_sec = -1;
+
+	if (icao && style == KML_LINE) {
+		simplifyInit(&k->simp, tolerance);
+		writeKMLpreamble(o, icao);
+		return k;
+	}
+
+	switch (style) {
+	case KML_GXTRACK: head = kml_gx_head; break;
+	case KML_GEOJSON: head = geojson_head; break;
+	default:          head = kml_multi_head; break;
+	}
+	p = outReserve(o, strlen(head));
+	p = fmtStr(p, head);
+	outCommit(o, p);
+	return k;
+}
+
+static int kmlNextFlightNumber(struct kmlexport *k, uint32_t addr) {
+	struct kmlflightcount **pc = &k->counts[kmlHash(addr)];
+	struct kmlflightcount *c;
+
+	for (c = *pc; c; c = c->next) {
+		if (c->addr == addr)
+			return ++c->flights;
+	}
+	c = malloc(sizeof(*c));
+	if (!c) {
+		fprintf(stderr, "Error. Out of memory\n");
+		exit(1);
+	}
+	c->addr = addr;
+	c->flights = 1;
+	c->next = *pc;
+	*pc = c;
+	return 1;
+}
+
+// "YYYY-MM-DDTHH:MM:SS[.mmm]Z", the date only recomputed when the second changes
+static char *kmlFmtTime(char *p, struct kmlexport *k, uint64_t ms, int millis) {
+	time_t sec = ms / 1000;
+
+	if (sec != k->date_sec) {
+		struct tm tm;
+
+		gmtime_r(&sec, &tm);
+		sprintf(k->date, "%04d-%02d-%02dT%02d:%02d:%02d",
+				tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+		k->date_sec = sec;
+	}
+	p = fmtStr(p, k->date);
+	if (millis) {
+		*p++ = '.';
+		p = fmtUIntPad(p, ms % 1000, 3);
+	}
+	*p++ = 'Z';
+	return p;
+}
+
+static void kmlWriteTime(struct kmlexport *k, const char *tag, uint64_t ms) {
+	char *p = outReserve(k->o, 64);
+
+	*p++ = '<'; p = fmtStr(p, tag); *p++ = '>';
+	p = kmlFmtTime(p, k, ms, 0);
+	*p++ = '<'; *p++ = '/'; p = fmtStr(p, tag); *p++ = '>';
+	outCommit(k->o, p);
+}
+
+static void kmlKeepPoint(struct kmlflight *f, const struct trackpoint *pt) {
+	if (f->npoints == f->size) {
+		f->size = f->size ? f->size * 2 : 64;
+		f->points = realloc(f->points, f->size * sizeof(*f->points));
+		if (!f->points) {
+			fprintf(stderr, "Error. Out of memory\n");
+			exit(1);
+		}
+	}
+	f->points[f->npoints++] = *pt;
+}
+
+// "ICAO 71BE34 AFL1234 #2", callsigns are only letters, digits and spaces
+// so nothing needs escaping in XML or JSON
+static char *kmlFmtName(char *p, struct kmlflight *f) {
+	p = fmtStr(p, "ICAO ");
+	p = fmtHex(p, f->addr, 6, 1);
+	if (f->callsign[0]) {
+		*p++ = ' ';
+		p = fmtStr(p, f->callsign);
+	}
+	if (f->number > 1) {
+		p = fmtStr(p, " #");
+		p = fmtUInt(p, f->number);
+	}
+	return p;
+}
+
+static void kmlWriteLine(struct kmlexport *k, struct kmlflight *f) {
+	struct outbuf *o = k->o;
+	char *p;
+	size_t j;
+
+	p = outReserve(o, 256);
+	p = fmtStr(p, "<Placemark><name>");
+	p = kmlFmtName(p, f);
+	p = fmtStr(p, "</name><description>Flight</description><TimeSpan>");
+	outCommit(o, p);
+	kmlWriteTime(k, "begin", f->points[0].time);
+	kmlWriteTime(k, "end", f->points[f->npoints - 1].time);
+	p = outReserve(o, 256);
+	p = fmtStr(p, "</TimeSpan><styleUrl>#yellowLineGreenPoly</styleUrl>"
+			"<LineString><extrude>1</extrude><tessellate>1</tessellate>"
+			"<altitudeMode>absolute</altitudeMode><coordinates>\r\n");
+	outCommit(o, p);
+
+	for (j = 0; j < f->npoints; j++)
+		kmlWritePoint(o, &f->points[j]);
+
+	p = outReserve(o, 64);
+	p = fmtStr(p, "</coordinates></LineString> </Placemark>\r\n");
+	outCommit(o, p);
+}
+
+static char *kmlFmtOptional(char *p, int v, const char *none) {
+	return v < 0 ? fmtStr(p, none) : fmtUInt(p, v);
+}
+
+static void kmlWriteGxValues(struct outbuf *o, struct kmlflight *f, const char *name, int heading) {
+	char *p;
+	size_t j;
+
+	p = outReserve(o, 64);
+	p = fmtStr(p, "<gx:SimpleArrayData name=\"");
+	p = fmtStr(p, name);
+	p = fmtStr(p, "\">\r\n");
+	outCommit(o, p);
+	for (j = 0; j < f->npoints; j++) {
+		p = outReserve(o, 32);
+		p = fmtStr(p, "<gx:value>");
+		p = kmlFmtOptional(p, heading ? f->points[j].heading : f->points[j].speed, "");
+		p = fmtStr(p, "</gx:value>\r\n");
+		outCommit(o, p);
+	}
+	p = outReserve(o, 32);
+	p = fmtStr(p, "</gx:SimpleArrayData>");
+	outCommit(o, p);
+}
+
+static void kmlWriteGxTrack(struct kmlexport *k, struct kmlflight *f) {
+	struct outbuf *o = k->o;
+	char *p;
+	size_t j;
+
+	p = outReserve(o, 256);
+	p = fmtStr(p, "<Placemark><name>");
+	p = kmlFmtName(p, f);
+	p = fmtStr(p, "</name><description>Flight</description><styleUrl>#yellowLineGreenPoly</styleUrl>"
+			"<gx:Track><altitudeMode>absolute</altitudeMode>\r\n");
+	outCommit(o, p);
+
+	for (j = 0; j < f->npoints; j++) {
+		p = outReserve(o, 64);
+		p = fmtStr(p, "<when>");
+		p = kmlFmtTime(p, k, f->points[j].time, 1);
+		p = fmtStr(p, "</when>\r\n");
+		outCommit(o, p);
+	}
+	for (j = 0; j < f->npoints; j++) {
+		p = outReserve(o, 96);
+		p = fmtStr(p, "<gx:coord>");
+		p = fmtFixed(p, f->points[j].lon, 5); *p++ = ' ';
+		p = fmtFixed(p, f->points[j].lat, 5); *p++ = ' ';
+		p = fmtFixed(p, (float) f->points[j].alt*0.3048, 1);
+		p = fmtStr(p, "</gx:coord>\r\n");
+		outCommit(o, p);
+	}
+
+	p = outReserve(o, 64);
+	p = fmtStr(p, "<ExtendedData><SchemaData schemaUrl=\"#flight\">");
+	outCommit(o, p);
+	kmlWriteGxValues(o, f, "speed", 0);
+	kmlWriteGxValues(o, f, "heading", 1);
+	p = outReserve(o, 64);
+	p = fmtStr(p, "</SchemaData></ExtendedData></gx:Track> </Placemark>\r\n");
+	outCommit(o, p);
+}
+
+// A GeoJSON array of the flight points, one per line
+static void kmlWriteJSONList(struct kmlexport *k, struct kmlflight *f, const char *name, int what) {
+	struct outbuf *o = k->o;
+	struct trackpoint *pt;
+	char *p;
+	size_t j;
+
+	p = outReserve(o, 32);
+	p = fmtStr(p, ",\"");
+	p = fmtStr(p, name);
+	p = fmtStr(p, "\":[");
+	outCommit(o, p);
+	for (j = 0; j < f->npoints; j++) {
+		pt = &f->points[j];
+		p = outReserve(o, 96);
+		if (j)
+			*p++ = ',';
+		*p++ = '\r'; *p++ = '\n';
+		switch (what) {
+		case 0:
+			*p++ = '[';
+			p = fmtFixed(p, pt->lon, 5); *p++ = ',';
+			p = fmtFixed(p, pt->lat, 5); *p++ = ',';
+			p = fmtFixed(p, (float) pt->alt*0.3048, 1);
+			*p++ = ']';
+			break;
+		case 1:
+			*p++ = '"';
+			p = kmlFmtTime(p, k, pt->time, 1);
+			*p++ = '"';
+			break;
+		case 2:
+			p = kmlFmtOptional(p, pt->speed, "null");
+			break;
+		default:
+			p = kmlFmtOptional(p, pt->heading, "null");
+			break;
+		}
+		outCommit(o, p);
+	}
+	p = outReserve(o, 4);
+	*p++ = ']';
+	outCommit(o, p);
+}
+
+// The times go in "coordTimes" of the properties, as other GeoJSON tools
+// expect them, the speeds and headings in lists next to it
+static void kmlWriteGeoJSON(struct kmlexport *k, struct kmlflight *f) {
+	struct outbuf *o = k->o;
+	char *p;
+
+	p = outReserve(o, 256);
+	if (k->features++)
+		*p++ = ',';
+	p = fmtStr(p, "\r\n{\"type\":\"Feature\",\"properties\":{\"name\":\"");
+	p = kmlFmtName(p, f);
+	p = fmtStr(p, "\",\"icao\":\"");
+	p = fmtHex(p, f->addr, 6, 1);
+	p = fmtStr(p, "\",\"callsign\":");
+	if (f->callsign[0]) {
+		*p++ = '"';
+		p = fmtStr(p, f->callsign);
+		*p++ = '"';
+	} else {
+		p = fmtStr(p, "null");
+	}
+	p = fmtStr(p, ",\"flight\":");
+	p = fmtUInt(p, f->number);
+	outCommit(o, p);
+	kmlWriteJSONList(k, f, "coordTimes", 1);
+	kmlWriteJSONList(k, f, "speeds", 2);
+	kmlWriteJSONList(k, f, "headings", 3);
+
+	p = outReserve(o, 64);
+	p = fmtStr(p, "},\"geometry\":{\"type\":\"LineString\"");
+	outCommit(o, p);
+	kmlWriteJSONList(k, f, "coordinates", 0);
+	p = outReserve(o, 4);
+	*p++ = '}'; *p++ = '}';
+	outCommit(o, p);
+}
+
+static void kmlWriteFlight(struct kmlexport *k, struct kmlflight *f) {
+	if (!f->npoints)
+		return;
+
+	switch (k->style) {
+	case KML_GXTRACK: kmlWriteGxTrack(k, f); break;
+	case KML_GEOJSON: kmlWriteGeoJSON(k, f); break;
+	default:          kmlWriteLine(k, f); break;
+	}
+}
+
+// Write the flight out and forget it
+static void kmlEndFlight(struct kmlexport *k, struct kmlflight *f) {
+	struct kmlflight **pf = &k->hash[kmlHash(f->addr)];
+	struct trackpoint pt;
+
+	if (simplifyFlush(&f->simp, &pt))
+		kmlKeepPoint(f, &pt);
+	k->points_in += f->simp.in;
+	k->points_out += f->simp.out;
+
+	kmlWriteFlight(k, f);
+
+	while (*pf != f)
+		pf = &(*pf)->hash_next;
+	*pf = f->hash_next;
+
+	if (f->prev) f->prev->next = f->next; else k->first = f->next;
+	if (f->next) f->next->prev = f->prev; else k->last = f->prev;
+
+	free(f->points);
+	free(f);
+}
+
+// Last point heard, kept or held back by the simplifier
+static uint64_t kmlLastTime(struct kmlflight *f) {
+	if (f->simp.n)
+		return f->simp.window[f->simp.n - 1].time;
+	return f->points[f->npoints - 1].time;
+}
+
+static void kmlExpire(struct kmlexport *k, uint64_t now) {
+	struct kmlflight *f, *next;
+
+	for (f = k->first; f; f = next) {
+		next = f->next;
+		if (now > kmlLastTime(f) + KML_FLIGHT_GAP)
+			kmlEndFlight(k, f);
+	}
+}
+
+static void kmlSetCallsign(struct kmlflight *f, const char *callsign) {
+	int j;
+
+	memcpy(f->callsign, callsign, sizeof(f->callsign));
+	// Trailing spaces of the callsign are of no use in a name
+	for (j = 8; j > 0 && (f->callsign[j - 1] == ' ' || f->callsign[j - 1] == '\0'); j--)
+		f->callsign[j - 1] = '\0';
+}
+
+void kmlAddMessage(struct kmlexport *k, struct modesMessage *mm) {
+	struct kmlflight *f;
+	struct trackpoint pt, kept;
+	unsigned h;
+
+	if (k->icao && k->style == KML_LINE) {
+		if (mm->addr == k->icao && kmlPosition(mm, &pt) && simplifyAdd(&k->simp, &pt, &kept))
+			kmlWritePoint(k->o, &kept);
+		return;
+	}
+	if (k->icao && mm->addr != k->icao)
+		return;
+
+	h = kmlHash(mm->addr);
+	for (f = k->hash[h]; f; f = f->hash_next) {
+		if (f->addr == mm->addr)
+			break;
+	}
+
+	// Name the flight after the first callsign heard during it
+	if (f && mm->callsign_valid && !f->callsign[0])
+		kmlSetCallsign(f, mm->callsign);
+
+	// Speed and heading come in other messages than the positions
+	if (f && mm->speed_valid)
+		f->speed = mm->speed;
+	if (f && mm->heading_valid)
+		f->heading = mm->heading;
+
+	if (!kmlPosition(mm, &pt))
+		return;
+
+	// A long silence ends the flight, the aircraft starts a new one
+	if (f && pt.time > kmlLastTime(f) + KML_FLIGHT_GAP) {
+		kmlEndFlight(k, f);
+		f = NULL;
+	}
+
+	if (!f) {
+		f = calloc(1, sizeof(*f));
+		if (!f) {
+			fprintf(stderr, "Error. Out of memory\n");
+			exit(1);
+		}
+		f->addr = mm->addr;
+		f->number = kmlNextFlightNumber(k, mm->addr);
+		f->speed = -1;
+		f->heading = -1;
+		simplifyInit(&f->simp, k->tolerance);
+		f->hash_next = k->hash[h];
+		k->hash[h] = f;
+		f->prev = k->last;
+		if (k->last) k->last->next = f; else k->first = f;
+		k->last = f;
+
+		// The callsign may have come before the first position
+		if (mm->aircraft.callsign_valid)
+			kmlSetCallsign(f, mm->aircraft.callsign);
+		if (mm->aircraft.speed_valid)
+			f->speed = mm->aircraft.speed;
+		if (mm->aircraft.heading_valid)
+			f->heading = mm->aircraft.heading;
+	}
+
+	pt.speed = f->speed;
+	pt.heading = f->heading;
+	if (simplifyAdd(&f->simp, &pt, &kept)) {
+		kmlKeepPoint(f, &kept);
+
+		// Write out a long flight in parts, the next one starting where
+		// this one ended
+		if (f->npoints == KML_FLIGHT_POINTS) {
+			kmlWriteFlight(k, f);
+			f->points[0] = f->points[f->npoints - 1];
+			f->npoints = 1;
+		}
+	}
+
+	// Now and then write out the flights that are over, to bound memory
+	if ((++k->points & 0xFFF) == 0)
+		kmlExpire(k, pt.time);
+}
+
+void kmlClose(struct kmlexport *k, uint64_t *points_in, uint64_t *points_out) {
+	struct kmlflightcount *c, *next;
+	struct trackpoint pt;
+	char *p;
+	int j;
+
+	if (k->icao && k->style == KML_LINE) {
+		if (simplifyFlush(&k->simp, &pt))
+			kmlWritePoint(k->o, &pt);
+		k->points_in = k->simp.in;
+		k->points_out = k->simp.out;
+		writeKMLend(k->o);
+	} else {
+		const char *end = k->style == KML_GEOJSON ? geojson_end : kml_multi_end;
+
+		while (k->first)
+			kmlEndFlight(k, k->first);
+
+		p = outReserve(k->o, strlen(end));
+		p = fmtStr(p, end);
+		outCommit(k->o, p);
+	}
+
+	*points_in = k->points_in;
+	*points_out = k->points_out;
+
+	for (j = 0; j < KML_HASH_SIZE; j++) {
+		for (c = k->counts[j]; c; c = next) {
+			next = c->next;
+			free(c);
+		}
+	}
+	free(k);
+}
+
+//
+//=========================================================================
+//
+// KMZ: a zip archive holding doc.kml, deflated while it is written. The
+// KML text goes through a stdio stream of our own (fopencookie) so the
+// output buffers and the writer thread don't need to know about it. The
+// sizes are not known in advance, so they follow the data (bit 3 of the
+// zip flags) and are repeated in the central directory at the end.
+//
+
+#if defined(HAVE_ZLIB) && defined(__GLIBC__)
+
+#define KMZ_ENTRY "doc.kml"
+
+struct kmz {
+	FILE     *f;            // The real file
+	z_stream  z;
+	uint32_t  crc;
+	uint64_t  usize, csize;
+	uint16_t  dos_time, dos_date;
+	unsigned char out[64*1024];
+};
+
+static void kmzPut16(unsigned char *p, unsigned v) { p[0] = v; p[1] = v >> 8; }
+static void kmzPut32(unsigned char *p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+static int kmzDeflate(struct kmz *z, int flush) {
+	int ret;
+
+	do {
+		size_t n;
+
+		z->z.next_out = z->out;
+		z->z.avail_out = sizeof(z->out);
+		ret = deflate(&z->z, flush);
+		if (ret == Z_STREAM_ERROR)
+			return -1;
+		n = sizeof(z->out) - z->z.avail_out;
+		if (n && fwrite(z->out, 1, n, z->f) != n)
+			return -1;
+		z->csize += n;
+	} while (z->z.avail_out == 0);
+
+	return 0;
+}
+
+static ssize_t kmzWrite(void *cookie, const char *buf, size_t len) {
+	struct kmz *z = cookie;
+
+	z->crc = crc32(z->crc, (const Bytef *) buf, len);
+	z->usize += len;
+	z->z.next_in = (Bytef *) buf;
+	z->z.avail_in = len;
+	if (kmzDeflate(z, Z_NO_FLUSH) < 0)
+		return -1;
+	return len;
+}
+
+static int kmzClose(void *cookie) {
+	struct kmz *z = cookie;
+	unsigned char h[46 + sizeof(KMZ_ENTRY)];
+	uint64_t cd_offset;
+	int err = 0;
+
+	z->z.next_in = NULL;
+	z->z.avail_in = 0;
+	if (kmzDeflate(z, Z_FINISH) < 0)
+		err = -1;
+	deflateEnd(&z->z);
+
+	// Data descriptor
+	kmzPut32(h, 0x08074b50);
+	kmzPut32(h + 4, z->crc);
+	kmzPut32(h + 8, (uint32_t) z->csize);
+	kmzPut32(h + 12, (uint32_t) z->usize);
+	if (fwrite(h, 1, 16, z->f) != 16)
+		err = -1;
+	cd_offset = 30 + strlen(KMZ_ENTRY) + z->csize + 16;
+
+	// Central directory
+	memset(h, 0, sizeof(h));
+	kmzPut32(h, 0x02014b50);
+	kmzPut16(h + 4, 20);
+	kmzPut16(h + 6, 20);
+	kmzPut16(h + 8, 0x0008);
+	kmzPut16(h + 10, 8);
+	kmzPut16(h + 12, z->dos_time);
+	kmzPut16(h + 14, z->dos_date);
+	kmzPut32(h + 16, z->crc);
+	kmzPut32(h + 20, (uint32_t) z->csize);
+	kmzPut32(h + 24, (uint32_t) z->usize);
+	kmzPut16(h + 28, strlen(KMZ_ENTRY));
+	memcpy(h + 46, KMZ_ENTRY, strlen(KMZ_ENTRY));
+	if (fwrite(h, 1, 46 + strlen(KMZ_ENTRY), z->f) != 46 + strlen(KMZ_ENTRY))
+		err = -1;
+
+	// End of central directory
+	memset(h, 0, 22);
+	kmzPut32(h, 0x06054b50);
+	kmzPut16(h + 8, 1);
+	kmzPut16(h + 10, 1);
+	kmzPut32(h + 12, 46 + strlen(KMZ_ENTRY));
+	kmzPut32(h + 16, (uint32_t) cd_offset);
+	if (fwrite(h, 1, 22, z->f) != 22)
+		err = -1;
+
+	if (z->usize > 0xFFFFFFFFULL || z->csize > 0xFFFFFFFFULL) {
+		fprintf(stderr, "Error. KMZ output is larger than 4 GB, zip64 is not supported\n");
+		err = -1;
+	}
+
+	if (fclose(z->f) != 0)
+		err = -1;
+	free(z);
+	return err;
+}
+
+FILE *kmzOpen(FILE *f) {
+	cookie_io_functions_t io = { NULL, kmzWrite, NULL, kmzClose };
+	unsigned char h[30 + sizeof(KMZ_ENTRY)];
+	struct kmz *z = calloc(1, sizeof(*z));
+	time_t now = time(NULL);
+	struct tm tm;
+	FILE *stream;
+
+	if (!z || deflateInit2(&z->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		fprintf(stderr, "Error. Unable to start KMZ compression\n");
+		exit(1);
+	}
+	z->f = f;
+	z->crc = crc32(0, Z_NULL, 0);
+
+	localtime_r(&now, &tm);
+	z->dos_time = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+	z->dos_date = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+
+	// Local file header, sizes and CRC come in the data descriptor
+	memset(h, 0, sizeof(h));
+	kmzPut32(h, 0x04034b50);
+	kmzPut16(h + 4, 20);
+	kmzPut16(h + 6, 0x0008);
+	kmzPut16(h + 8, 8);
+	kmzPut16(h + 10, z->dos_time);
+	kmzPut16(h + 12, z->dos_date);
+	kmzPut16(h + 26, strlen(KMZ_ENTRY));
+	memcpy(h + 30, KMZ_ENTRY, strlen(KMZ_ENTRY));
+	if (fwrite(h, 1, 30 + strlen(KMZ_ENTRY), f) != 30 + strlen(KMZ_ENTRY)) {
+		fprintf(stderr, "Error. Write error on KMZ output\n");
+		exit(1);
+	}
+
+	stream = fopencookie(z, "w", io);
+	if (!stream) {
+		fprintf(stderr, "Error. Unable to open KMZ stream\n");
+		exit(1);
+	}
+	return stream;
+}
+
+#else
+
+FILE *kmzOpen(FILE *f) {
+	MODES_NOTUSED(f);
+	fprintf(stderr, "Error. KMZ output needs zlib, this build has no KMZ support\n");
+	exit(1);
+}
+
+#endif
@@ -1,14 +1,39 @@
-#ifndef KMLEXPORT_H_INCLUDED
-#define KMLEXPORT_H_INCLUDED
-
-#include <stdio.h>
-#include "beastblackbox.h"
-struct modesMessage;
-
-void writeKMLpreamble(FILE *f, uint32_t icao);
-void writeKMLcoordinates(FILE *f, struct modesMessage *mm);
-void writeKMLend(FILE *f);
-
-
-#endif // KMLEXPORT_H_INCLUDED
-
+#ifndef KMLEXPORT_H_INCLUDED
+#define KMLEXPORT_H_INCLUDED
+
+#include <stdio.h>
+#include "beastblackbox.h"
+struct modesMessage;
+
+struct outbuf;
+struct kmlexport;
+
+/* A flight ends after this much message time without positions, in ms */
+#define KML_FLIGHT_GAP (30*60*1000)
+
+/* Points of a flight held in memory at most, a longer one is written in parts */
+#define KML_FLIGHT_POINTS 65536
+
+/* Track documents */
+typedef enum {
+    KML_LINE,       // KML LineString, coordinates only
+    KML_GXTRACK,    // KML gx:Track with time, speed and heading of each point
+    KML_GEOJSON     // GeoJSON FeatureCollection, the same per point data
+} kml_style_t;
+
+// Track of one aircraft, or of all aircraft (icao 0), one Placemark or
+// Feature per flight written when the flight ends. A KML_LINE of one
+// aircraft is written as the messages come.
+// Positions are simplified to the tolerance in metres (0 keeps all).
+struct kmlexport *kmlOpen(struct outbuf *o, kml_style_t style, uint32_t icao, double tolerance);
+void kmlAddMessage(struct kmlexport *k, struct modesMessage *mm);
+// Completes the document, returns how many points were given and written
+void kmlClose(struct kmlexport *k, uint64_t *points_in, uint64_t *points_out);
+
+// Wrap a file in a stream that writes a KMZ (zipped doc.kml) to it.
+// Closing the stream completes the archive and closes the file.
+FILE *kmzOpen(FILE *f);
+
+
+#endif // KMLEXPORT_H_INCLUDED
+
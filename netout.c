@@ -0,0 +1,555 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// netout.c: outputs served to TCP clients
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+//
+// An output whose file is "tcp:[address:]port" is served to TCP clients
+// (SBS on port 30003, BEAST for --replay-tcp...). Messages are formatted
+// once, into a shared block of NET_BLOCK_SIZE, and every client queues
+// references to the part of the block it still has to send; a block is
+// freed when the last client is done with it. Sockets are non-blocking and
+// written with writev straight from the blocks.
+//
+// When a client's queue is full the output's policy says whether its
+// messages are dropped, it is disconnected, or everybody waits for it.
+//
+// All the servers are polled together (epoll on Linux), from the thread
+// which writes the outputs.
+//
+
+enum { NET_LISTENER, NET_CLIENT };
+
+struct netblock {
+    unsigned refs;          // The outbuf filling it, and queued references
+    char     data[NET_BLOCK_SIZE];
+};
+
+struct netref {
+    struct netblock *block;
+    size_t   off;
+    size_t   len;
+};
+
+struct netclient {
+    int      type;          // NET_CLIENT, first for the poller
+    int      fd;
+    int      dead;          // Closed, freed at the next sweep
+    struct netserver *server;
+    char     name[64];
+
+    struct netref queue[NET_QUEUE_REFS];
+    unsigned head;          // First reference not sent
+    unsigned n;             // References queued
+    size_t   queued;        // Bytes queued
+    uint64_t seq;           // Last message queued or dropped
+    uint64_t sent;
+    uint64_t dropped;
+};
+
+struct netserver {
+    int      type;          // NET_LISTENER, first for the poller
+    int      fd;
+    net_policy_t policy;
+    struct netclient *clients[NET_MAX_CLIENTS];
+    int      nclients;
+
+    struct netblock *block; // Being filled by the outbuf
+    size_t   published;     // Bytes of it handed to the clients
+    struct timespec start;
+
+    struct netstats stats;
+};
+
+static struct {
+    int      poll_fd;       // epoll, -1 until the first server
+    struct netserver *servers[MAX_SINKS];
+    int      nservers;
+} net = { -1, { NULL }, 0 };
+
+static void netRelease(struct netblock *b)
+{
+    if (--b->refs == 0)
+        free(b);
+}
+
+static struct netblock *netNewBlock(void)
+{
+    struct netblock *b = malloc(sizeof(*b));
+
+    if (!b) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+    b->refs = 1;
+    return b;
+}
+
+static void netWatch(int fd, void *owner, int add)
+{
+#ifdef __linux__
+    struct epoll_event ev;
+
+    ev.events = add ? EPOLLIN : (EPOLLIN | EPOLLOUT | EPOLLET);
+    ev.data.ptr = owner;
+    epoll_ctl(net.poll_fd, EPOLL_CTL_ADD, fd, &ev);
+#else
+    MODES_NOTUSED(fd);
+    MODES_NOTUSED(owner);
+    MODES_NOTUSED(add);
+#endif
+}
+
+// Close now, free at the next sweep: events may still point at it
+static void netKill(struct netclient *c, const char *why)
+{
+    if (c->dead)
+        return;
+    fprintf(stderr, "Network: %s %s, %llu bytes sent, %llu messages dropped\n", c->name, why,
+            (long long unsigned) c->sent, (long long unsigned) c->dropped);
+    close(c->fd);
+    c->dead = 1;
+    c->server->stats.sent += c->sent;
+    c->server->stats.dropped += c->dropped;
+}
+
+static void netSweep(void)
+{
+    struct netserver *s;
+    struct netclient *c;
+    int i, j;
+
+    for (i = 0; i < net.nservers; i++) {
+        s = net.servers[i];
+        for (j = 0; j < s->nclients; ) {
+            c = s->clients[j];
+            if (!c->dead) {
+                j++;
+                continue;
+            }
+            for (; c->n; c->n--, c->head = (c->head + 1) % NET_QUEUE_REFS)
+                netRelease(c->queue[c->head].block);
+            free(c);
+            s->clients[j] = s->clients[--s->nclients];
+        }
+    }
+}
+
+// Write what the socket takes, straight from the blocks
+static void netSend(struct netclient *c)
+{
+    struct iovec iov[64];
+    struct netref *r;
+    ssize_t n;
+    int i;
+
+    while (c->n && !c->dead) {
+        for (i = 0; i < 64 && (unsigned) i < c->n; i++) {
+            r = &c->queue[(c->head + i) % NET_QUEUE_REFS];
+            iov[i].iov_base = r->block->data + r->off;
+            iov[i].iov_len = r->len;
+        }
+
+        n = writev(c->fd, iov, i);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n <= 0) {
+            netKill(c, "disconnected");
+            return;
+        }
+
+        c->sent += n;
+        c->queued -= n;
+        while (n > 0) {
+            r = &c->queue[c->head];
+            if ((size_t) n < r->len) {
+                r->off += n;
+                r->len -= n;
+                break;
+            }
+            n -= r->len;
+            netRelease(r->block);
+            c->head = (c->head + 1) % NET_QUEUE_REFS;
+            c->n--;
+        }
+    }
+}
+
+static void netAccept(struct netserver *s)
+{
+    struct sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    char host[48], port[8];
+    struct netclient *c;
+    int fd, one = 1;
+
+    while ((fd = accept(s->fd, (struct sockaddr *) &addr, &addrlen)) != -1) {
+        if (s->nclients == NET_MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        c = calloc(1, sizeof(*c));
+        if (!c) {
+            fprintf(stderr, "Error. Out of memory\n");
+            exit(1);
+        }
+        c->type = NET_CLIENT;
+        c->fd = fd;
+        c->server = s;
+        c->seq = s->stats.messages;
+        if (getnameinfo((struct sockaddr *) &addr, addrlen, host, sizeof(host), port, sizeof(port),
+                        NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+            strcpy(host, "?"), strcpy(port, "?");
+        snprintf(c->name, sizeof(c->name), "%s:%s on port %d", host, port, s->stats.port);
+
+        netWatch(fd, c, 0);
+        s->clients[s->nclients++] = c;
+        s->stats.clients++;
+        fprintf(stderr, "Network: %s connected\n", c->name);
+        addrlen = sizeof(addr);
+    }
+}
+
+// Something to read from a client: commands are not understood, only the
+// end of the connection matters
+static void netRead(struct netclient *c)
+{
+    char buf[256];
+    ssize_t n;
+
+    while ((n = recv(c->fd, buf, sizeof(buf), 0)) > 0)
+        ;
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        netKill(c, "disconnected");
+}
+
+void netPoll(int timeout)
+{
+#ifdef __linux__
+    struct epoll_event events[64];
+    int n, j;
+
+    if (net.poll_fd == -1)
+        return;
+    if (timeout > NET_POLL_MS)
+        timeout = NET_POLL_MS;
+
+    n = epoll_wait(net.poll_fd, events, 64, timeout);
+    for (j = 0; j < n; j++) {
+        struct netclient *c = events[j].data.ptr;
+
+        if (c->type == NET_LISTENER) {
+            netAccept(events[j].data.ptr);
+            continue;
+        }
+        if (events[j].events & (EPOLLERR | EPOLLHUP))
+            netKill(c, "disconnected");
+        if ((events[j].events & EPOLLIN) && !c->dead)
+            netRead(c);
+        if ((events[j].events & EPOLLOUT) && !c->dead)
+            netSend(c);
+    }
+#else
+    struct pollfd fds[MAX_SINKS * (NET_MAX_CLIENTS + 1)];
+    void *owner[MAX_SINKS * (NET_MAX_CLIENTS + 1)];
+    int n = 0, i, j;
+
+    if (timeout > NET_POLL_MS)
+        timeout = NET_POLL_MS;
+
+    for (i = 0; i < net.nservers; i++) {
+        struct netserver *s = net.servers[i];
+
+        fds[n].fd = s->fd;
+        fds[n].events = POLLIN;
+        owner[n++] = s;
+        for (j = 0; j < s->nclients; j++) {
+            fds[n].fd = s->clients[j]->fd;
+            fds[n].events = POLLIN | (s->clients[j]->n ? POLLOUT : 0);
+            owner[n++] = s->clients[j];
+        }
+    }
+    if (!n || poll(fds, n, timeout) <= 0)
+        return;
+
+    for (j = 0; j < n; j++) {
+        struct netclient *c = owner[j];
+
+        if (!fds[j].revents)
+            continue;
+        if (c->type == NET_LISTENER) {
+            netAccept(owner[j]);
+            continue;
+        }
+        if (fds[j].revents & (POLLERR | POLLHUP))
+            netKill(c, "disconnected");
+        if ((fds[j].revents & POLLIN) && !c->dead)
+            netRead(c);
+        if ((fds[j].revents & POLLOUT) && !c->dead)
+            netSend(c);
+    }
+#endif
+    netSweep();
+}
+
+int netServers(void)
+{
+    return net.nservers;
+}
+
+int netClients(void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < net.nservers; i++)
+        n += net.servers[i]->nclients;
+    return n;
+}
+
+int netPolicy(const char *name)
+{
+    if (!strcmp(name, "drop"))
+        return NET_DROP;
+    if (!strcmp(name, "disconnect"))
+        return NET_DISCONNECT;
+    if (!strcmp(name, "block"))
+        return NET_BLOCK;
+    return -1;
+}
+
+struct netserver *netOpen(const char *listen_on, net_policy_t policy)
+{
+    struct netserver *s = calloc(1, sizeof(*s));
+    struct addrinfo hints, *res;
+    char *host = strdup(listen_on);
+    char *port = strrchr(host, ':');
+    int err, one = 1;
+
+    if (port)
+        *port++ = '\0';
+    else
+        port = host, host = NULL;
+
+    if (net.nservers == MAX_SINKS || !s) {
+        fprintf(stderr, "Error. Too many network outputs\n");
+        exit(1);
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    err = getaddrinfo(host, port, &hints, &res);
+    if (err) {
+        fprintf(stderr, "Error. Unable to listen on %s: %s\n", listen_on, gai_strerror(err));
+        exit(1);
+    }
+
+    // A client which goes away must not kill us
+    signal(SIGPIPE, SIG_IGN);
+
+    s->type = NET_LISTENER;
+    s->policy = policy;
+    s->stats.port = atoi(port);
+    s->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (s->fd == -1 ||
+        setsockopt(s->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1 ||
+        bind(s->fd, res->ai_addr, res->ai_addrlen) == -1 ||
+        listen(s->fd, 16) == -1) {
+        fprintf(stderr, "Error. Unable to listen on %s: %s\n", listen_on, strerror(errno));
+        exit(1);
+    }
+    fcntl(s->fd, F_SETFL, fcntl(s->fd, F_GETFL) | O_NONBLOCK);
+    freeaddrinfo(res);
+    free(host ? host : port);
+
+#ifdef __linux__
+    if (net.poll_fd == -1)
+        net.poll_fd = epoll_create1(0);
+    if (net.poll_fd == -1) {
+        fprintf(stderr, "Error. Unable to poll network outputs: %s\n", strerror(errno));
+        exit(1);
+    }
+#endif
+    netWatch(s->fd, s, 1);
+
+    clock_gettime(CLOCK_MONOTONIC, &s->start);
+    net.servers[net.nservers++] = s;
+    return s;
+}
+
+void netOutInit(struct outbuf *o, struct netserver *s)
+{
+    memset(o, 0, sizeof(*o));
+    o->net = s;
+    s->block = netNewBlock();
+    s->published = 0;
+    o->buf = s->block->data;
+    o->size = NET_BLOCK_SIZE;
+}
+
+// Queue a message for a client, or apply the policy. Returns -1 to wait.
+static int netQueue(struct netserver *s, struct netclient *c, size_t off, size_t len)
+{
+    struct netref *last = c->n ? &c->queue[(c->head + c->n - 1) % NET_QUEUE_REFS] : NULL;
+
+    if (c->queued + len > NET_QUEUE_SIZE || c->n == NET_QUEUE_REFS) {
+        switch (s->policy) {
+        case NET_DROP:
+            c->dropped++;
+            c->seq = s->stats.messages;
+            return 0;
+        case NET_DISCONNECT:
+            s->stats.evicted++;
+            netKill(c, "too slow, disconnected");
+            return 0;
+        case NET_BLOCK:
+            return -1;
+        }
+    }
+
+    c->seq = s->stats.messages;
+    c->queued += len;
+    if (last && last->block == s->block && last->off + last->len == off) {
+        last->len += len;
+    } else {
+        last = &c->queue[(c->head + c->n) % NET_QUEUE_REFS];
+        last->block = s->block;
+        last->off = off;
+        last->len = len;
+        s->block->refs++;
+        c->n++;
+    }
+    netSend(c);
+    return 0;
+}
+
+void netOutPublish(struct outbuf *o)
+{
+    struct netserver *s = o->net;
+    size_t len = o->len - s->published;
+    int j;
+
+    if (!len)
+        return;
+
+    s->stats.messages++;
+    s->stats.bytes += len;
+
+    for (j = 0; j < s->nclients && !Modes.exit; j++) {
+        struct netclient *c = s->clients[j];
+
+        if (c->dead || c->seq == s->stats.messages)
+            continue;
+        if (netQueue(s, c, s->published, len) < 0) {
+            // Clients may come and go meanwhile, start over
+            netPoll(NET_POLL_MS);
+            j = -1;
+        }
+    }
+    s->published = o->len;
+    netSweep();
+}
+
+// The block is full: the clients keep it, the part of a message not
+// published yet moves on to a new one
+void netOutFlush(struct outbuf *o)
+{
+    struct netserver *s = o->net;
+    struct netblock *b = netNewBlock();
+    size_t len = o->len - s->published;
+
+    memcpy(b->data, s->block->data + s->published, len);
+    netRelease(s->block);
+    s->block = b;
+    s->published = 0;
+    o->buf = b->data;
+    o->len = len;
+}
+
+void netOutFree(struct outbuf *o)
+{
+    struct netserver *s = o->net;
+
+    netOutPublish(o);
+    netRelease(s->block);
+    s->block = NULL;
+    o->buf = NULL;
+    o->len = 0;
+}
+
+void netClose(struct netserver *s, struct netstats *stats)
+{
+    struct timespec now;
+    uint64_t waited = 0;
+    int i, queued = 1;
+
+    while (queued && !Modes.exit && waited < NET_DRAIN_MS) {
+        for (queued = i = 0; i < s->nclients; i++)
+            queued |= (s->clients[i]->n != 0);
+        if (queued) {
+            netPoll(NET_POLL_MS);
+            waited += NET_POLL_MS;
+        }
+    }
+
+    for (i = 0; i < s->nclients; i++)
+        netKill(s->clients[i], "done");
+    netSweep();
+    close(s->fd);
+
+    for (i = 0; i < net.nservers && net.servers[i] != s; i++)
+        ;
+    net.servers[i] = net.servers[--net.nservers];
+    if (!net.nservers && net.poll_fd != -1) {
+        close(net.poll_fd);
+        net.poll_fd = -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    s->stats.msecs = (now.tv_sec - s->start.tv_sec) * 1000 + (now.tv_nsec - s->start.tv_nsec) / 1000000;
+    *stats = s->stats;
+    free(s);
+}
+
+void netPrintStats(FILE *f, const char *name, struct netstats *s)
+{
+    double secs = s->msecs ? s->msecs / 1000.0 : 0.001;
+
+    fprintf(f, "Network %s on port %d: %llu messages (%llu bytes) to %u clients, %llu bytes sent (%.1f KB/s), "
+           "%llu dropped, %u disconnected as too slow\n",
+           name, s->port, (long long unsigned) s->messages, (long long unsigned) s->bytes, s->clients,
+           (long long unsigned) s->sent, s->sent / secs / 1024.0, (long long unsigned) s->dropped, s->evicted);
+}
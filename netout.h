@@ -0,0 +1,91 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// netout.h: outputs served to TCP clients
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NETOUT_H_INCLUDED
+#define NETOUT_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Clients of one output served at once */
+#define NET_MAX_CLIENTS  64
+
+/* Shared buffer the messages are formatted into */
+#define NET_BLOCK_SIZE   (64*1024)
+
+/* Bytes, and pieces of shared buffers, queued for a client which doesn't
+ * keep up */
+#define NET_QUEUE_SIZE   (1024*1024)
+#define NET_QUEUE_REFS   1024
+
+/* Longest time without looking at Modes.exit, in milliseconds */
+#define NET_POLL_MS      100
+
+/* Time given to the clients to take what is queued at the end */
+#define NET_DRAIN_MS     5000
+
+/* What to do with a client whose queue is full */
+typedef enum {
+    NET_DROP,               // Drop the messages it has no room for
+    NET_DISCONNECT,         // Close the connection
+    NET_BLOCK               // Wait for it, everything slows down
+} net_policy_t;
+
+struct netserver;
+struct outbuf;
+
+/* Counters of a server, left once it is closed */
+struct netstats {
+    int      port;
+    unsigned clients;       // Connections accepted
+    unsigned evicted;       // Closed as too slow (NET_DISCONNECT)
+    uint64_t messages;      // Messages formatted, once for all clients
+    uint64_t bytes;
+    uint64_t sent;          // Bytes sent, summed over clients
+    uint64_t dropped;       // Messages dropped for a client, summed over clients
+    uint64_t msecs;         // Time the server was open
+};
+
+// Policy from its name (drop, disconnect, block), -1 if unknown
+int  netPolicy(const char *name);
+
+// Listen on "[address:]port" (all addresses by default)
+struct netserver *netOpen(const char *listen, net_policy_t policy);
+
+// Format into shared buffers of the server: netOutPublish() hands what
+// was written since the last one (a message) to all the clients without
+// copying it, outFlush() only moves on to a new buffer when this one is full
+void netOutInit(struct outbuf *o, struct netserver *s);
+void netOutPublish(struct outbuf *o);
+void netOutFlush(struct outbuf *o);
+void netOutFree(struct outbuf *o);
+
+// Look after the sockets of all servers for up to timeout milliseconds
+void netPoll(int timeout);
+
+// Number of servers open, and of clients connected to all of them
+int  netServers(void);
+int  netClients(void);
+
+// Let the clients take what is queued, then close everything
+void netClose(struct netserver *s, struct netstats *stats);
+
+void netPrintStats(FILE *f, const char *name, struct netstats *stats);
+
+#endif // NETOUT_H_INCLUDED
@@ -0,0 +1,298 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// output.c: buffered text output
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+// A buffer of the writer pool, with the output it has to go to
+struct outchunk {
+    struct outbuf *o;
+    char          *data;
+    size_t         len;
+};
+
+static struct {
+    int             async;
+    pthread_t       thread;
+    struct ring     queue;        // filled chunks, decoder -> writer
+    struct ring     free;         // written chunks, writer -> decoder
+    struct outchunk chunks[OUTPUT_CHUNKS];
+} writer;
+
+static void outWriteError(void) {
+    if (Modes.exit)
+        return;
+    fprintf(stderr, "Error. Write error on output: %s\n", strerror(errno));
+    exit(1);
+}
+
+static void *outWriterThread(void *arg) {
+    struct outchunk *c;
+
+    MODES_NOTUSED(arg);
+
+    while ((c = ringPop(&writer.queue)) != NULL) {
+        // stdio writes a block this big directly, after its own pending data
+        if (fwrite(c->data, 1, c->len, c->o->f) != c->len || fflush(c->o->f))
+            outWriteError();
+        c->len = 0;
+        ringPush(&writer.free, c);
+    }
+    return NULL;
+}
+
+void outWriterStart(int async) {
+    sigset_t old;
+    int j;
+
+    writer.async = async;
+    if (!async)
+        return;
+
+    ringInit(&writer.queue, OUTPUT_CHUNKS);
+    ringInit(&writer.free, OUTPUT_CHUNKS);
+    for (j = 0; j < OUTPUT_CHUNKS; j++) {
+        writer.chunks[j].data = malloc(OUTPUT_BUFFER_SIZE);
+        if (!writer.chunks[j].data) {
+            fprintf(stderr, "Error. Out of memory\n");
+            exit(1);
+        }
+        ringPush(&writer.free, &writer.chunks[j]);
+    }
+
+    signalsBlock(&old);
+    if (pthread_create(&writer.thread, NULL, outWriterThread, NULL)) {
+        fprintf(stderr, "Error. Unable to start output writer thread\n");
+        exit(1);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void outWriterStop(void) {
+    int j;
+
+    if (!writer.async)
+        return;
+
+    ringClose(&writer.queue);
+    pthread_join(writer.thread, NULL);
+
+    for (j = 0; j < OUTPUT_CHUNKS; j++)
+        free(writer.chunks[j].data);
+    ringDestroy(&writer.queue);
+    ringDestroy(&writer.free);
+}
+
+void outWriterStats(FILE *f) {
+    if (!writer.async)
+        return;
+    fprintf(f, "Output writer: outputs waited %.3f s for free buffers, queue depth max %u of %d\n",
+            writer.free.pop_wait_ns / 1e9, writer.queue.max_depth, OUTPUT_CHUNKS);
+}
+
+// Take an empty chunk from the pool, waiting for the writer if needed
+static void outTakeChunk(struct outbuf *o) {
+    o->chunk = ringPop(&writer.free);
+    o->chunk->o = o;
+    o->buf = o->chunk->data;
+    o->size = OUTPUT_BUFFER_SIZE;
+    o->len = 0;
+}
+
+void outInit(struct outbuf *o, FILE *f) {
+    o->f = f;
+    o->len = 0;
+    o->size = OUTPUT_BUFFER_SIZE;
+    o->chunk = NULL;
+    o->net = NULL;
+
+    if (writer.async) {
+        outTakeChunk(o);
+        return;
+    }
+
+    o->buf = malloc(o->size);
+    if (!o->buf) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+}
+
+void outFlush(struct outbuf *o) {
+    if (!o->len)
+        return;
+
+    if (o->net) {
+        netOutFlush(o);
+        return;
+    }
+
+    if (o->chunk) {
+        o->chunk->len = o->len;
+        ringPush(&writer.queue, o->chunk);
+        outTakeChunk(o);
+        return;
+    }
+
+    // stdio writes a block this big directly, after its own pending data
+    if (fwrite(o->buf, 1, o->len, o->f) != o->len)
+        outWriteError();
+    o->len = 0;
+}
+
+void outFree(struct outbuf *o) {
+    if (!o->buf)
+        return;
+
+    if (o->net) {
+        netOutFree(o);
+        return;
+    }
+
+    if (o->chunk) {
+        // The last chunk goes to the writer, the spare one stays in the
+        // pool memory until outWriterStop()
+        if (o->len) {
+            o->chunk->len = o->len;
+            ringPush(&writer.queue, o->chunk);
+        }
+        o->chunk = NULL;
+    } else {
+        outFlush(o);
+        fflush(o->f);
+        free(o->buf);
+    }
+    o->buf = NULL;
+    o->len = 0;
+}
+
+char *fmtStr(char *p, const char *s) {
+    while (*s)
+        *p++ = *s++;
+    return p;
+}
+
+char *fmtUInt(char *p, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n)
+        *p++ = tmp[--n];
+    return p;
+}
+
+char *fmtInt(char *p, int64_t v) {
+    if (v < 0) {
+        *p++ = '-';
+        return fmtUInt(p, -(uint64_t) v);
+    }
+    return fmtUInt(p, v);
+}
+
+char *fmtUIntPad(char *p, unsigned v, int width) {
+    char tmp[10];
+    int n = 0;
+
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (width-- > n)
+        *p++ = '0';
+    while (n)
+        *p++ = tmp[--n];
+    return p;
+}
+
+char *fmtHex(char *p, uint64_t v, int width, int upper) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char tmp[16];
+    int n = 0;
+
+    do {
+        tmp[n++] = digits[v & 15];
+        v >>= 4;
+    } while (v);
+    while (width-- > n)
+        *p++ = '0';
+    while (n)
+        *p++ = tmp[--n];
+    return p;
+}
+
+char *fmtFixed(char *p, double v, int decimals) {
+    static const double scale[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    double a, s, r;
+    uint64_t whole, frac;
+
+    if (decimals < 0 || decimals > 9 || !isfinite(v) || fabs(v) >= 9e18)
+        return p + sprintf(p, "%.*f", decimals, v);
+
+    // The whole part and the remaining fraction are both exact doubles
+    a = fabs(v);
+    whole = (uint64_t) a;
+    s = (a - (double) whole) * scale[decimals];
+    r = nearbyint(s);
+    // Near a tie the product may have rounded the other way than printf
+    // would round the exact binary value, let printf decide
+    if (fabs(fabs(s - r) - 0.5) < 1e-6)
+        return p + sprintf(p, "%.*f", decimals, v);
+
+    frac = (uint64_t) r;
+    if (frac == (uint64_t) scale[decimals]) {
+        whole++;
+        frac = 0;
+    }
+
+    if (signbit(v))
+        *p++ = '-';
+    p = fmtUInt(p, whole);
+    if (decimals) {
+        *p++ = '.';
+        p = fmtUIntPad(p, (unsigned) frac, decimals);
+    }
+    return p;
+}
+
+char *fmtDate(char *p, struct outdate *cache, time_t sec, int local, char sep) {
+    if (!cache->len || cache->sec != sec || cache->local != local || cache->sep != sep) {
+        struct tm tm;
+        char *t = cache->text;
+
+        if (local) localtime_r(&sec, &tm);
+        else gmtime_r(&sec, &tm);
+
+        t = fmtUIntPad(t, tm.tm_year + 1900, 4); *t++ = '/';
+        t = fmtUIntPad(t, tm.tm_mon + 1, 2);     *t++ = '/';
+        t = fmtUIntPad(t, tm.tm_mday, 2);        *t++ = sep;
+        t = fmtUIntPad(t, tm.tm_hour, 2);        *t++ = ':';
+        t = fmtUIntPad(t, tm.tm_min, 2);         *t++ = ':';
+        t = fmtUIntPad(t, tm.tm_sec, 2);         *t++ = '.';
+
+        cache->sec = sec;
+        cache->local = local;
+        cache->sep = sep;
+        cache->len = t - cache->text;
+    }
+    memcpy(p, cache->text, cache->len);
+    return p + cache->len;
+}
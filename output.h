@@ -0,0 +1,95 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// output.h: buffered text output prototypes
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OUTPUT_H_INCLUDED
+#define OUTPUT_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Text collected before it is handed to stdio in one piece */
+#define OUTPUT_BUFFER_SIZE (256*1024)
+
+/* Longest text a single outReserve() may ask for (one decoded message) */
+#define OUTPUT_MAX_LINE    4096
+
+/* Buffers shared by all outputs when a writer thread does the I/O */
+#define OUTPUT_CHUNKS      32
+
+struct outchunk;
+struct netserver;
+
+// Decoded messages are formatted straight into a big buffer with the
+// fmt* helpers below, then written out in bulk: by the decoding thread
+// itself (--sync-output), or by the writer thread, so that a slow disk or
+// terminal doesn't hold up decoding. Anything printed to the same stream
+// should go through the buffer too, to keep the order.
+struct outbuf {
+    FILE   *f;
+    char   *buf;
+    size_t  len;
+    size_t  size;
+    struct outchunk *chunk; // Buffer borrowed from the writer, NULL if synchronous
+    struct netserver *net;  // Served to TCP clients instead (netOutInit)
+};
+
+// Start the writer thread (async) or not, before the first outInit()
+void  outWriterStart(int async);
+// Wait until everything is written, after the last outFree()
+void  outWriterStop(void);
+// Print how much the decoder had to wait for the writer
+void  outWriterStats(FILE *f);
+
+void  outInit(struct outbuf *o, FILE *f);
+void  outFlush(struct outbuf *o);
+void  outFree(struct outbuf *o);
+
+// Room for at least n bytes (n <= OUTPUT_MAX_LINE), write there and call
+// outCommit() with the end of what was written
+static inline char *outReserve(struct outbuf *o, size_t n) {
+    if (o->len + n > o->size)
+        outFlush(o);
+    return o->buf + o->len;
+}
+
+static inline void outCommit(struct outbuf *o, char *end) {
+    o->len = end - o->buf;
+}
+
+// Number formatting, each returns the end of the written text
+char *fmtStr(char *p, const char *s);
+char *fmtUInt(char *p, uint64_t v);
+char *fmtInt(char *p, int64_t v);
+char *fmtUIntPad(char *p, unsigned v, int width);    // zero padded, like %0*u
+char *fmtHex(char *p, uint64_t v, int width, int upper); // zero padded, like %0*x
+char *fmtFixed(char *p, double v, int decimals);    // like %.*f
+
+// "YYYY/MM/DD<sep>HH:MM:SS." of a time, recomputed only when the second changes
+struct outdate {
+    time_t sec;
+    int    local;
+    char   sep;
+    char   text[24];
+    int    len;
+};
+
+char *fmtDate(char *p, struct outdate *cache, time_t sec, int local, char sep);
+
+#endif // OUTPUT_H_INCLUDED
@@ -0,0 +1,541 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// pack.c: compact archive of BEAST logs (--pack, --unpack)
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+//
+// A packed archive is the BEAST stream cut into blocks of up to
+// PACK_BLOCK_RECORDS frames. Within a block, like fields are stored
+// together so they compress well: the timestamps as differences to the
+// previous frame (zigzag varints), the signal levels, and the messages
+// grouped by downlink format, whose first byte is kept apart to know
+// the group when unpacking. Anything in the stream that is not a frame
+// escaped the usual way is kept as it is, so unpacking gives the very
+// same bytes back.
+//
+// All numbers are little-endian. The file starts with "BBXPACK\0",
+// u32 version, u32 0. Each block has a header:
+//   char[4] "BBLK", u32 records, u32 stored size, u32 size, u32 BEAST size,
+//   u8 compression, u8[3] 0, u64 first timestamp, u64 offset in the BEAST stream
+// followed by its data, compressed with zstd or zlib when that helps:
+//   u32 sizes of the timestamps, the run lengths, the runs and the 33 groups,
+//   record types (0 for a run of other bytes, else the BEAST frame type),
+//   first message bytes, signal levels, timestamps, run lengths (varints),
+//   runs, then the groups: DF 0 to 31 and Mode A/C.
+// A block is read without the ones before it, and the header tells
+// where the next one starts.
+//
+
+static const unsigned char pack_magic[8] = PACK_MAGIC;
+
+static int packPayloadLen(int type) {
+    switch (type) {
+    case '1': return MODEAC_MSG_BYTES;
+    case '2': return MODES_SHORT_MSG_BYTES;
+    case '3': return MODES_LONG_MSG_BYTES;
+    default:  return 0;
+    }
+}
+
+static void packPut32(unsigned char *p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void packPut64(unsigned char *p, uint64_t v) {
+    packPut32(p, (uint32_t) v);
+    packPut32(p + 4, (uint32_t) (v >> 32));
+}
+
+static uint32_t packGet32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t packGet64(const unsigned char *p) {
+    return packGet32(p) | ((uint64_t) packGet32(p + 4) << 32);
+}
+
+static unsigned char *packPutVarint(unsigned char *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char) v;
+    return p;
+}
+
+static const unsigned char *packGetVarint(const unsigned char *p, const unsigned char *end, uint64_t *v) {
+    int shift = 0;
+
+    *v = 0;
+    while (p < end && shift < 64) {
+        *v |= (uint64_t) (*p & 0x7f) << shift;
+        if (!(*p++ & 0x80))
+            return p;
+        shift += 7;
+    }
+    return NULL;
+}
+
+// The 48 bit clock may go back (merged receivers) or wrap
+static uint64_t packZigzag(uint64_t ts, uint64_t prev) {
+    int64_t d = (int64_t) (((ts - prev) & 0xFFFFFFFFFFFFULL) << 16) >> 16;
+
+    return ((uint64_t) d << 1) ^ (uint64_t) (d >> 63);
+}
+
+static uint64_t packUnzigzag(uint64_t z, uint64_t prev) {
+    int64_t d = (int64_t) (z >> 1) ^ -(int64_t) (z & 1);
+
+    return (prev + (uint64_t) d) & 0xFFFFFFFFFFFFULL;
+}
+
+int packParseBlock(const unsigned char *p, struct packblock *b) {
+    if (memcmp(p, "BBLK", 4))
+        return 0;
+    b->records = packGet32(p + 4);
+    b->stored = packGet32(p + 8);
+    b->size = packGet32(p + 12);
+    b->beast = packGet32(p + 16);
+    b->compression = p[20];
+    b->timestamp = packGet64(p + 24);
+    b->offset = packGet64(p + 32);
+    return b->records <= PACK_BLOCK_RECORDS && b->beast <= PACK_BLOCK_BEAST &&
+           b->size <= PACK_BLOCK_DATA && b->stored <= PACK_BLOCK_DATA + PACK_BLOCK_DATA / 8;
+}
+
+//
+// ============================== Unpacking ================================
+//
+static unsigned char *packEscape(unsigned char *p, const unsigned char *data, int len) {
+    int j;
+
+    for (j = 0; j < len; j++) {
+        *p++ = data[j];
+        if (data[j] == 0x1A)
+            *p++ = 0x1A;
+    }
+    return p;
+}
+
+ssize_t packDecodeBlock(const struct packblock *b, const unsigned char *data, unsigned char *out) {
+    unsigned char *plain = NULL;
+    const unsigned char *sec[PACK_SECTIONS], *secend[PACK_SECTIONS];
+    const unsigned char *types, *heads, *rssi, *p, *end;
+    unsigned char *o = out, frame[7 + MODES_LONG_MSG_BYTES];
+    uint64_t ts = b->timestamp, v;
+    uint32_t frames = 0, j, n;
+    int k, len, g;
+
+    switch (b->compression) {
+    case PACK_STORED:
+        if (b->stored != b->size)
+            return -1;
+        p = data;
+        break;
+#ifdef HAVE_ZLIB
+    case PACK_ZLIB: {
+        uLongf dlen = b->size;
+
+        plain = malloc(b->size);
+        if (!plain || uncompress(plain, &dlen, data, b->stored) != Z_OK || dlen != b->size)
+            goto bad;
+        p = plain;
+        break;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case PACK_ZSTD:
+        plain = malloc(b->size);
+        if (!plain || ZSTD_decompress(plain, b->size, data, b->stored) != b->size)
+            goto bad;
+        p = plain;
+        break;
+#endif
+    default:
+        return -1;
+    }
+    end = p + b->size;
+
+    // Find the sections
+    if (b->size < 4 * PACK_SECTIONS + b->records)
+        goto bad;
+    types = p + 4 * PACK_SECTIONS;
+    for (j = 0; j < b->records; j++) {
+        if (types[j])
+            frames++;
+    }
+    heads = types + b->records;
+    rssi = heads + frames;
+    sec[0] = rssi + frames;
+    for (k = 0; k < PACK_SECTIONS; k++) {
+        if (sec[k] > end || packGet32(p + 4 * k) > (size_t) (end - sec[k]))
+            goto bad;
+        secend[k] = sec[k] + packGet32(p + 4 * k);
+        if (k + 1 < PACK_SECTIONS)
+            sec[k + 1] = secend[k];
+    }
+
+    for (j = 0; j < b->records; j++) {
+        if (!types[j]) {
+            // Bytes that were not a frame, as they were
+            sec[1] = packGetVarint(sec[1], secend[1], &v);
+            if (!sec[1] || v > (uint64_t) (secend[2] - sec[2]) || (size_t) (o - out) + v > PACK_BLOCK_BEAST)
+                goto bad;
+            memcpy(o, sec[2], v);
+            o += v;
+            sec[2] += v;
+            continue;
+        }
+
+        len = packPayloadLen(types[j]);
+        if (!len)
+            goto bad;
+        sec[0] = packGetVarint(sec[0], secend[0], &v);
+        if (!sec[0])
+            goto bad;
+        ts = packUnzigzag(v, ts);
+
+        for (k = 0; k < 6; k++)
+            frame[k] = (unsigned char) (ts >> (8 * (5 - k)));
+        frame[6] = *rssi++;
+        frame[7] = *heads++;
+        g = (types[j] == '1') ? 32 : frame[7] >> 3;
+        n = len - 1;
+        if (n > (uint32_t) (secend[3 + g] - sec[3 + g]) || (size_t) (o - out) + 2 * (7 + len) + 2 > PACK_BLOCK_BEAST)
+            goto bad;
+        memcpy(frame + 8, sec[3 + g], n);
+        sec[3 + g] += n;
+
+        *o++ = 0x1A;
+        *o++ = types[j];
+        o = packEscape(o, frame, 7 + len);
+    }
+
+    if ((size_t) (o - out) != b->beast)
+        goto bad;
+    free(plain);
+    return o - out;
+
+bad:
+    free(plain);
+    return -1;
+}
+
+//
+// =============================== Packing =================================
+//
+struct packer {
+    FILE          *f;
+    uint32_t       records;
+    uint32_t       frames;
+    unsigned char  types[PACK_BLOCK_RECORDS];
+    unsigned char  heads[PACK_BLOCK_RECORDS];
+    unsigned char  rssi[PACK_BLOCK_RECORDS];
+    uint64_t       ts[PACK_BLOCK_RECORDS];
+    uint32_t       runlen[PACK_BLOCK_RECORDS];
+    unsigned char  raw[PACK_BLOCK_RAW];
+    uint32_t       nraw;
+    unsigned char *group[PACK_GROUPS];
+    uint32_t       ngroup[PACK_GROUPS];
+    uint32_t       beast;           // BEAST bytes of this block
+
+    unsigned char *plain;           // block being put together
+    unsigned char *packed;          // and compressed
+    size_t         packed_size;
+
+    uint64_t       offset;          // BEAST bytes before this block
+    uint64_t       out_bytes;
+    uint64_t       total_frames;
+    uint64_t       total_raw;
+};
+
+static void packFlush(struct packer *pk) {
+    unsigned char header[PACK_BLOCK_HEADER], *p, *sizes;
+    uint64_t prev = pk->frames ? pk->ts[0] : 0;
+    const unsigned char *data;
+    size_t size, stored;
+    uint32_t j, f;
+    int k, compression = PACK_STORED;
+
+    if (!pk->records)
+        return;
+
+    // Put the sections together
+    sizes = pk->plain;
+    p = sizes + 4 * PACK_SECTIONS;
+    memcpy(p, pk->types, pk->records); p += pk->records;
+    memcpy(p, pk->heads, pk->frames);  p += pk->frames;
+    memcpy(p, pk->rssi, pk->frames);   p += pk->frames;
+
+    data = p;
+    for (f = 0; f < pk->frames; f++) {
+        p = packPutVarint(p, packZigzag(pk->ts[f], prev));
+        prev = pk->ts[f];
+    }
+    packPut32(sizes, p - data);
+
+    data = p;
+    for (j = 0; j < pk->records; j++) {
+        if (!pk->types[j])
+            p = packPutVarint(p, pk->runlen[j]);
+    }
+    packPut32(sizes + 4, p - data);
+
+    memcpy(p, pk->raw, pk->nraw); p += pk->nraw;
+    packPut32(sizes + 8, pk->nraw);
+
+    for (k = 0; k < PACK_GROUPS; k++) {
+        memcpy(p, pk->group[k], pk->ngroup[k]);
+        p += pk->ngroup[k];
+        packPut32(sizes + 12 + 4 * k, pk->ngroup[k]);
+    }
+    size = p - pk->plain;
+
+    // Compress, unless it doesn't help
+    data = pk->plain;
+    stored = size;
+#if defined(HAVE_ZSTD)
+    {
+        size_t n = ZSTD_compress(pk->packed, pk->packed_size, pk->plain, size, 3);
+        if (!ZSTD_isError(n) && n < size) {
+            data = pk->packed;
+            stored = n;
+            compression = PACK_ZSTD;
+        }
+    }
+#elif defined(HAVE_ZLIB)
+    {
+        uLongf n = pk->packed_size;
+        if (compress2(pk->packed, &n, pk->plain, size, 6) == Z_OK && n < size) {
+            data = pk->packed;
+            stored = n;
+            compression = PACK_ZLIB;
+        }
+    }
+#endif
+
+    memcpy(header, "BBLK", 4);
+    packPut32(header + 4, pk->records);
+    packPut32(header + 8, (uint32_t) stored);
+    packPut32(header + 12, (uint32_t) size);
+    packPut32(header + 16, pk->beast);
+    header[20] = compression;
+    header[21] = header[22] = header[23] = 0;
+    packPut64(header + 24, pk->frames ? pk->ts[0] : 0);
+    packPut64(header + 32, pk->offset);
+
+    if (fwrite(header, sizeof(header), 1, pk->f) != 1 || fwrite(data, stored, 1, pk->f) != 1) {
+        fprintf(stderr, "Error. Unable to write the packed archive\n");
+        exit(1);
+    }
+    pk->out_bytes += sizeof(header) + stored;
+
+    pk->offset += pk->beast;
+    pk->total_frames += pk->frames;
+    pk->total_raw += pk->nraw;
+    pk->records = pk->frames = pk->nraw = pk->beast = 0;
+    memset(pk->ngroup, 0, sizeof(pk->ngroup));
+}
+
+// One frame, unescaped: 6 bytes of timestamp, signal level, message
+static void packFrame(struct packer *pk, int type, const unsigned char *frame, int escaped_len) {
+    int len = packPayloadLen(type);
+    int g = (type == '1') ? 32 : frame[7] >> 3;
+    uint64_t ts = 0;
+    int k;
+
+    if (pk->records == PACK_BLOCK_RECORDS)
+        packFlush(pk);
+
+    for (k = 0; k < 6; k++)
+        ts = (ts << 8) | frame[k];
+
+    pk->types[pk->records++] = type;
+    pk->ts[pk->frames] = ts;
+    pk->rssi[pk->frames] = frame[6];
+    pk->heads[pk->frames++] = frame[7];
+    memcpy(pk->group[g] + pk->ngroup[g], frame + 8, len - 1);
+    pk->ngroup[g] += len - 1;
+    pk->beast += escaped_len;
+}
+
+static void packRawByte(struct packer *pk, unsigned char c) {
+    if (pk->nraw == PACK_BLOCK_RAW || (pk->records == PACK_BLOCK_RECORDS && pk->types[pk->records - 1]))
+        packFlush(pk);
+
+    if (!pk->records || pk->types[pk->records - 1]) {
+        pk->types[pk->records] = 0;
+        pk->runlen[pk->records++] = 0;
+    }
+    pk->runlen[pk->records - 1]++;
+    pk->raw[pk->nraw++] = c;
+    pk->beast++;
+}
+
+// A frame escaped exactly as packDecodeBlock() will write it again.
+// Returns its length, 0 if p doesn't start one, -1 if more data is needed.
+static int packScanFrame(const unsigned char *p, size_t avail, unsigned char *frame) {
+    int need, got = 0;
+    size_t i = 2;
+
+    if (avail < 2)
+        return avail && p[0] != 0x1A ? 0 : -1;
+    if (p[0] != 0x1A || !(need = packPayloadLen(p[1])))
+        return 0;
+
+    need += 7;
+    while (got < need) {
+        if (i >= avail)
+            return -1;
+        if (p[i] == 0x1A) {
+            if (i + 1 >= avail)
+                return -1;
+            if (p[i + 1] != 0x1A)
+                return 0;
+            i++;
+        }
+        frame[got++] = p[i++];
+    }
+    return (int) i;
+}
+
+static void packArchive(struct beastinput *in, FILE *f) {
+    struct packer *pk = calloc(1, sizeof(*pk));
+    unsigned char header[PACK_FILE_HEADER];
+    unsigned char frame[7 + MODES_LONG_MSG_BYTES];
+    unsigned char *buf = malloc(INPUT_READAHEAD + MAX_MSG_LEN);
+    size_t pos = 0, avail = 0;
+    ssize_t n;
+    int eof = 0, len, k;
+
+    if (!pk || !buf) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+    pk->f = f;
+    for (k = 0; k < PACK_GROUPS; k++)
+        pk->group[k] = malloc(PACK_BLOCK_RECORDS * MODES_LONG_MSG_BYTES);
+    pk->plain = malloc(PACK_BLOCK_DATA);
+#if defined(HAVE_ZSTD)
+    pk->packed_size = ZSTD_compressBound(PACK_BLOCK_DATA);
+#elif defined(HAVE_ZLIB)
+    pk->packed_size = compressBound(PACK_BLOCK_DATA);
+#endif
+    pk->packed = malloc(pk->packed_size ? pk->packed_size : 1);
+
+    memcpy(header, pack_magic, 8);
+    packPut32(header + 8, PACK_VERSION);
+    packPut32(header + 12, 0);
+    if (fwrite(header, sizeof(header), 1, f) != 1) {
+        fprintf(stderr, "Error. Unable to write the packed archive\n");
+        exit(1);
+    }
+    pk->out_bytes = sizeof(header);
+
+    while (!eof || pos < avail) {
+        if (!eof) {
+            avail -= pos;
+            memmove(buf, buf + pos, avail);
+            pos = 0;
+            n = inputRead(in, (char *) buf + avail, INPUT_READAHEAD + MAX_MSG_LEN - avail);
+            if (n <= 0)
+                eof = 1;
+            else
+                avail += n;
+        }
+
+        while (pos < avail) {
+            len = packScanFrame(buf + pos, avail - pos, frame);
+            if (len < 0 && !eof)
+                break;
+            if (len > 0) {
+                packFrame(pk, buf[pos + 1], frame, len);
+                pos += len;
+            } else {
+                packRawByte(pk, buf[pos++]);
+            }
+        }
+    }
+    packFlush(pk);
+
+    fprintf(stderr, "Packed %llu frames and %llu other bytes, %llu BEAST bytes into %llu (%.1f%%)\n",
+            (long long unsigned) pk->total_frames, (long long unsigned) pk->total_raw,
+            (long long unsigned) pk->offset, (long long unsigned) pk->out_bytes,
+            pk->offset ? 100.0 * pk->out_bytes / pk->offset : 0.0);
+
+    for (k = 0; k < PACK_GROUPS; k++)
+        free(pk->group[k]);
+    free(pk->plain);
+    free(pk->packed);
+    free(pk);
+    free(buf);
+}
+
+// Packed input is expanded by input.c, what comes out is plain BEAST
+static void packUnarchive(struct beastinput *in, FILE *f) {
+    char *buf = malloc(INPUT_READAHEAD);
+    ssize_t n;
+
+    if (in->format != INPUT_PACKED)
+        fprintf(stderr, "Warning. BEAST file %s is not a packed archive, copying it as it is\n", in->filename);
+
+    while ((n = inputRead(in, buf, INPUT_READAHEAD)) > 0) {
+        if (fwrite(buf, n, 1, f) != 1) {
+            fprintf(stderr, "Error. Unable to write the unpacked BEAST file\n");
+            exit(1);
+        }
+    }
+    free(buf);
+}
+
+void packRun(void) {
+    const char *path = Modes.filename_pack ? Modes.filename_pack : Modes.filename_unpack;
+    struct beastinput in;
+    FILE *f;
+
+    if (Modes.nfilenames != 1) {
+        fprintf(stderr, "\nERROR: --pack and --unpack work with a single input file.\n\n");
+        exit(1);
+    }
+
+    inputOpen(&in, Modes.filenames[0], 0);
+    f = strcmp(path, "-") ? fopen(path, "wb") : stdout;
+    if (f == NULL) {
+        fprintf(stderr, "Error. Unable to open for write file %s\n", path);
+        exit(1);
+    }
+
+    if (Modes.filename_pack)
+        packArchive(&in, f);
+    else
+        packUnarchive(&in, f);
+
+    if (fclose(f) != 0) {
+        fprintf(stderr, "Error. Write error in file %s\n", path);
+        exit(1);
+    }
+    inputClose(&in);
+}
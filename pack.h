@@ -0,0 +1,75 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// pack.h: compact archive of BEAST logs (--pack, --unpack)
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PACK_H_INCLUDED
+#define PACK_H_INCLUDED
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* File magic, 8 bytes with the NUL */
+#define PACK_MAGIC        "BBXPACK"
+#define PACK_VERSION      1
+#define PACK_FILE_HEADER  16
+
+/* Records (frames or runs of other bytes) per block at most */
+#define PACK_BLOCK_RECORDS 4096
+
+/* Bytes that are not frames kept in one block at most */
+#define PACK_BLOCK_RAW     (32*1024)
+
+/* Block header size, and the most BEAST bytes a block expands to */
+#define PACK_BLOCK_HEADER  40
+#define PACK_BLOCK_BEAST   (PACK_BLOCK_RECORDS * 2 * (MODES_LONG_MSG_BYTES + 8) + PACK_BLOCK_RAW)
+
+/* Sections of the block data: timestamps, run lengths, runs, and the
+ * messages of DF 0 to 31 and Mode A/C */
+#define PACK_GROUPS        33
+#define PACK_SECTIONS      (3 + PACK_GROUPS)
+
+/* Most bytes of block data, uncompressed */
+#define PACK_BLOCK_DATA    (4 * PACK_SECTIONS + PACK_BLOCK_RECORDS * (3 + 10 + 5 + MODES_LONG_MSG_BYTES) + PACK_BLOCK_RAW)
+
+/* Compression of a block */
+#define PACK_STORED 0
+#define PACK_ZLIB   1
+#define PACK_ZSTD   2
+
+/* Header of a block, in front of its data */
+struct packblock {
+    uint32_t records;       // frames and runs of other bytes
+    uint32_t stored;        // bytes of data after the header
+    uint32_t size;          // bytes of data once uncompressed
+    uint32_t beast;         // bytes of BEAST the block expands to
+    int      compression;
+    uint64_t timestamp;     // of the first frame of the block
+    uint64_t offset;        // of the block in the BEAST stream
+};
+
+// --pack / --unpack of the single --filename input, then exit
+void packRun(void);
+
+// Read a block header, returns 0 if it is not one
+int packParseBlock(const unsigned char *p, struct packblock *b);
+
+// Expand the stored data of a block to BEAST (at most PACK_BLOCK_BEAST
+// bytes). Returns the number of bytes, -1 if the block is damaged.
+ssize_t packDecodeBlock(const struct packblock *b, const unsigned char *data, unsigned char *out);
+
+#endif // PACK_H_INCLUDED
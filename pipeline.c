@@ -0,0 +1,375 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// pipeline.c: decoding stages on separate threads
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+//
+// Decoding is split into stages, each on its own thread and each the only
+// one to touch its part of the program state:
+//
+//   reader   inputs, merging, message counters   (the main thread)
+//   decoder  frame parsing, CRC, ICAO filter     (mode_s.c, icao_filter.c)
+//   tracker  aircraft state, CPR decoding        (track.c)
+//   output   sinks and Modes.out                 (sink.c, then the writer)
+//
+// With --tracker-threads the tracker hands each batch to helper threads as
+// well, each one updating the aircraft of its own table (see trackShard),
+// and waits for all of them before the batch moves on.
+//
+// Frames go from stage to stage in batches over the rings, and the empty
+// batches go back from the output stage to the reader, so their number
+// bounds both the memory used and how far the reader can run ahead.
+// Every stage sees the messages in input order, so the output is the same
+// as with --no-pipeline, where the reader runs all the stages itself.
+//
+
+struct pipeframe {
+    int     input;
+    int     len;                // Escaped frame length, 0 if the decoder dropped it
+    uint64_t time;              // On the clock of the input, see mlatClockTime()
+    char    frame[MAX_MSG_LEN];
+    struct modesMessage mm;
+};
+
+struct pipebatch {
+    int     n;
+    int     flush;              // Outputs write what they have after this batch
+    int     progress;           // Frame to show progress before, -1 for none
+    int     progress_input;     // What the reader saw at that frame
+    int     progress_percent;
+    uint64_t progress_offset;
+    long long unsigned progress_msg;
+    struct pipeframe frames[PIPELINE_BATCH];
+};
+
+struct pipestage {
+    const char  *name;
+    void       (*run)(struct pipestage *s, struct pipebatch *b);
+    int          shard;         // Aircraft table of a tracker thread
+    struct ring *in;
+    struct ring *out;
+    pthread_t    thread;
+    uint64_t     run_ns;        // From start to the end of its input
+};
+
+enum { STAGE_DECODER, STAGE_TRACKER, STAGE_OUTPUT, STAGES };
+
+static struct {
+    int               threads;
+    struct ring       free;             // empty batches, output -> reader
+    struct ring       rings[STAGES];    // to each stage
+    struct pipestage  stages[STAGES];
+    struct ring       shard_in[MAX_TRACKER_THREADS];   // tracker -> helpers
+    struct ring       shard_done[MAX_TRACKER_THREADS]; // and back
+    struct pipestage  shards[MAX_TRACKER_THREADS];     // helpers, from 1 up
+    struct pipebatch *batches;
+    struct pipebatch *batch;            // being filled by the reader
+    struct timespec   start;
+    uint64_t          reader_ns;
+} pipeline;
+
+static uint64_t pipelineElapsed(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) (now.tv_sec - pipeline.start.tv_sec) * 1000000000ULL + now.tv_nsec - pipeline.start.tv_nsec;
+}
+
+// Goes with the decoded messages, and out right away
+static void pipelineShowProgress(int input, int percent, uint64_t offset, long long unsigned msg)
+{
+    const char *filename = Modes.inputs[input].filename;
+    char *p = outReserve(&Modes.out, strlen(filename) + 100);
+
+    if (Modes.ninputs == 1 && percent >= 0) p += sprintf(p, "Processing... File offset 0x%llX (%d%%), message #%llu\r", (long long unsigned) offset, percent, msg);
+    else p += sprintf(p, "Processing... File %s offset 0x%llX, message #%llu\r", filename, (long long unsigned) offset, msg);
+    outCommit(&Modes.out, p);
+    outFlush(&Modes.out);
+}
+
+static void pipelineDecode(struct pipestage *s, struct pipebatch *b)
+{
+    int i;
+
+    for (i = 0; i < b->n; i++) {
+        struct pipeframe *f = &b->frames[i];
+
+        icaoFilterExpire();
+        f->len = decodeBinMessage(f->frame, f->input, f->time, &f->mm);
+    }
+    MODES_NOTUSED(s);
+}
+
+// The messages of a batch for the aircraft of one table
+static void pipelineTrackShard(struct pipestage *s, struct pipebatch *b)
+{
+    int i;
+
+    trackExpire(s->shard);
+    for (i = 0; i < b->n; i++) {
+        struct pipeframe *f = &b->frames[i];
+
+        if (f->len && (Modes.tracker_threads == 1 || trackShard(f->mm.addr) == s->shard))
+            useModesMessage(&f->mm);
+    }
+}
+
+static void pipelineTrack(struct pipestage *s, struct pipebatch *b)
+{
+    int j;
+
+    for (j = 1; j < Modes.tracker_threads; j++)
+        ringPush(&pipeline.shard_in[j], b);
+
+    pipelineTrackShard(s, b);
+
+    for (j = 1; j < Modes.tracker_threads; j++)
+        ringPop(&pipeline.shard_done[j]);
+
+    // Every table is quiet now
+    trackCorrelate();
+}
+
+static void pipelineOutput(struct pipestage *s, struct pipebatch *b)
+{
+    int i;
+
+    for (i = 0; i < b->n; i++) {
+        struct pipeframe *f = &b->frames[i];
+
+        if (i == b->progress)
+            pipelineShowProgress(b->progress_input, b->progress_percent, b->progress_offset, b->progress_msg);
+        if (f->len)
+            sinkMessage(&f->mm, f->frame, f->len);
+    }
+    if (b->flush)
+        sinkFlushAll();
+    MODES_NOTUSED(s);
+}
+
+static void *pipelineThread(void *arg)
+{
+    struct pipestage *s = arg;
+    struct pipebatch *b;
+
+    while ((b = ringPop(s->in)) != NULL) {
+        s->run(s, b);
+        ringPush(s->out, b);
+    }
+    s->run_ns = pipelineElapsed();
+
+    // The next stage finishes what it has and stops too
+    if (s->out != &pipeline.free)
+        ringClose(s->out);
+    return NULL;
+}
+
+static void pipelineSpawn(struct pipestage *s)
+{
+    if (pthread_create(&s->thread, NULL, pipelineThread, s)) {
+        fprintf(stderr, "Error. Unable to start %s thread\n", s->name);
+        exit(1);
+    }
+}
+
+void pipelineStart(void)
+{
+    static const char *names[STAGES] = { "decoder", "tracker", "output" };
+    static void (*runs[STAGES])(struct pipestage *, struct pipebatch *) = { pipelineDecode, pipelineTrack, pipelineOutput };
+    sigset_t old;
+    int j;
+
+    pipeline.threads = !Modes.no_pipeline;
+    if (!pipeline.threads)
+        return;
+
+    pipeline.batches = malloc(PIPELINE_BATCHES * sizeof(struct pipebatch));
+    if (!pipeline.batches) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+    ringInit(&pipeline.free, PIPELINE_BATCHES);
+    for (j = 0; j < PIPELINE_BATCHES; j++)
+        ringPush(&pipeline.free, &pipeline.batches[j]);
+
+    for (j = 0; j < STAGES; j++)
+        ringInit(&pipeline.rings[j], PIPELINE_BATCHES);
+
+    // Signals are left to the reader, which is the one that has to stop
+    signalsBlock(&old);
+
+    clock_gettime(CLOCK_MONOTONIC, &pipeline.start);
+    for (j = 0; j < STAGES; j++) {
+        struct pipestage *s = &pipeline.stages[j];
+
+        s->name = names[j];
+        s->run = runs[j];
+        s->in = &pipeline.rings[j];
+        s->out = (j + 1 < STAGES) ? &pipeline.rings[j + 1] : &pipeline.free;
+        pipelineSpawn(s);
+    }
+
+    // The tracker thread does table 0 itself
+    for (j = 1; j < Modes.tracker_threads; j++) {
+        struct pipestage *s = &pipeline.shards[j];
+
+        ringInit(&pipeline.shard_in[j], 1);
+        ringInit(&pipeline.shard_done[j], 1);
+        s->name = "tracker";
+        s->run = pipelineTrackShard;
+        s->shard = j;
+        s->in = &pipeline.shard_in[j];
+        s->out = &pipeline.shard_done[j];
+        pipelineSpawn(s);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+// Hand the batch being filled over to the decoder. An empty one only
+// goes if the outputs have to be flushed.
+static void pipelineSend(int flush)
+{
+    struct pipebatch *b = pipeline.batch;
+
+    if (!b) {
+        if (!flush)
+            return;
+        b = ringPop(&pipeline.free);
+        b->n = 0;
+        b->progress = -1;
+    }
+    b->flush = flush;
+    pipeline.batch = NULL;
+    ringPush(&pipeline.rings[STAGE_DECODER], b);
+}
+
+void pipelineFrame(struct beastinput *in, char *frame, int len, int progress)
+{
+    struct pipebatch *b;
+    struct pipeframe *f;
+
+    if (!pipeline.threads) {
+        struct modesMessage mm;
+
+        if (progress)
+            pipelineShowProgress(in->index, inputProgress(in), inputConsumed(in), Modes.msg_processed);
+
+        icaoFilterExpire();
+        trackPeriodicUpdate();
+
+        if ((len = decodeBinMessage(frame, in->index, in->frame_time, &mm)) > 0) {
+            useModesMessage(&mm);
+            sinkMessage(&mm, frame, len);
+        }
+        return;
+    }
+
+    if (!(b = pipeline.batch)) {
+        b = pipeline.batch = ringPop(&pipeline.free);
+        b->n = 0;
+        b->progress = -1;
+    }
+
+    if (progress) {
+        b->progress = b->n;
+        b->progress_input = in->index;
+        b->progress_percent = inputProgress(in);
+        b->progress_offset = inputConsumed(in);
+        b->progress_msg = Modes.msg_processed;
+    }
+
+    f = &b->frames[b->n++];
+    f->input = in->index;
+    f->time = in->frame_time;
+    memcpy(f->frame, frame, len);
+
+    if (b->n == PIPELINE_BATCH)
+        pipelineSend(0);
+}
+
+void pipelineFlush(void)
+{
+    if (pipeline.threads)
+        pipelineSend(1);
+    else
+        sinkFlushAll();
+}
+
+void pipelineStop(void)
+{
+    int j;
+
+    if (!pipeline.threads)
+        return;
+
+    pipelineSend(0);
+    pipeline.reader_ns = pipelineElapsed();
+
+    ringClose(&pipeline.rings[STAGE_DECODER]);
+    for (j = 0; j < STAGES; j++)
+        pthread_join(pipeline.stages[j].thread, NULL);
+    for (j = 1; j < Modes.tracker_threads; j++) {
+        ringClose(&pipeline.shard_in[j]);
+        pthread_join(pipeline.shards[j].thread, NULL);
+    }
+
+    // The statistics stay in the rings
+    for (j = 0; j < STAGES; j++)
+        ringDestroy(&pipeline.rings[j]);
+    for (j = 1; j < Modes.tracker_threads; j++) {
+        ringDestroy(&pipeline.shard_in[j]);
+        ringDestroy(&pipeline.shard_done[j]);
+    }
+    ringDestroy(&pipeline.free);
+    free(pipeline.batches);
+}
+
+void pipelineStats(FILE *f)
+{
+    uint64_t idle;
+    int j, k;
+
+    if (!pipeline.threads)
+        return;
+
+    // Idle is the time a stage spent blocked on its rings (the reader on
+    // the outputs giving batches back), busy the rest until its input ended
+    idle = pipeline.free.pop_wait_ns + pipeline.rings[STAGE_DECODER].push_wait_ns;
+    fprintf(f, "Pipeline: reader busy %.3f s idle %.3f s", (pipeline.reader_ns - idle) / 1e9, idle / 1e9);
+    for (j = 0; j < STAGES; j++) {
+        struct pipestage *s = &pipeline.stages[j];
+
+        idle = s->in->pop_wait_ns + s->out->push_wait_ns;
+        if (j == STAGE_TRACKER)
+            for (k = 1; k < Modes.tracker_threads; k++)
+                idle += pipeline.shard_done[k].pop_wait_ns;
+        fprintf(f, ", %s busy %.3f s idle %.3f s", s->name, (s->run_ns - idle) / 1e9, idle / 1e9);
+    }
+    for (j = 1; j < Modes.tracker_threads; j++) {
+        struct pipestage *s = &pipeline.shards[j];
+
+        idle = s->in->pop_wait_ns + s->out->push_wait_ns;
+        fprintf(f, ", %s %d busy %.3f s idle %.3f s", s->name, j, (s->run_ns - idle) / 1e9, idle / 1e9);
+    }
+    fprintf(f, ", queue depth max %u/%u/%u of %d\n",
+            pipeline.rings[STAGE_DECODER].max_depth, pipeline.rings[STAGE_TRACKER].max_depth,
+            pipeline.rings[STAGE_OUTPUT].max_depth, PIPELINE_BATCHES);
+}
@@ -0,0 +1,50 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// pipeline.h: decoding stages on separate threads
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PIPELINE_H_INCLUDED
+#define PIPELINE_H_INCLUDED
+
+#include <stdio.h>
+
+/* Frames handed from one stage to the next at once */
+#define PIPELINE_BATCH   256
+
+/* Batches in flight, how far the reader may run ahead of the outputs */
+#define PIPELINE_BATCHES 16
+
+struct beastinput;
+
+// Start the decoder, tracker and output threads, unless --no-pipeline.
+// Call after sinkOpenAll(), before the first pipelineFrame().
+void pipelineStart(void);
+
+// Pass on a frame (still escaped) read from an input. progress asks for a
+// progress line to go out with it.
+void pipelineFrame(struct beastinput *in, char *frame, int len, int progress);
+
+// Have the outputs write what they have so far (end of available input)
+void pipelineFlush(void);
+
+// Wait until every frame passed on went through all stages, stop the threads
+void pipelineStop(void);
+
+// Print how busy each stage was
+void pipelineStats(FILE *f);
+
+#endif // PIPELINE_H_INCLUDED
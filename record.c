@@ -0,0 +1,240 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// record.c: logs of a feeder with wall clock sync records
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+//
+// --record writes what a feeder sends, like flightdata.sh did with nc, to
+// logs named after the time they start. Every --record-sync seconds, and
+// at the start of each log, a sync record pairs the receiver timestamp of
+// the next frame with the UNIX time it was received at, so the decoder
+// can tell the real time of any part of a log, days after its start,
+// whatever the receiver clock did.
+//
+// Frames are collected in a buffer and appended with one write when it is
+// full, or when the data has been in memory for --record-fsync seconds;
+// fdatasync follows that write. A new log is started every --record-rotate
+// minutes.
+//
+
+struct recorder {
+    char    *prefix;
+    uint64_t sync_ns;
+    uint64_t rotate_ns;
+    uint64_t fsync_ns;
+
+    int      fd;            // -1 before the first frame
+    char     name[PATH_MAX];
+    uint64_t opened;        // UNIX time of the start of the log
+    uint64_t synced;        // Of the last sync record
+    uint64_t flushed;       // Of the last write and fdatasync
+
+    char    *buf;
+    size_t   len;
+
+    struct recordstats stats;
+};
+
+static uint64_t recordNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void recordWrite(struct recorder *r)
+{
+    size_t n = 0;
+    ssize_t w;
+
+    while (n < r->len && r->fd != -1) {
+        w = write(r->fd, r->buf + n, r->len - n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0) {
+            fprintf(stderr, "Error. Write error in file %s: %s\n", r->name, strerror(errno));
+            break;
+        }
+        n += w;
+    }
+    r->stats.bytes += n;
+    r->len = 0;
+}
+
+static void recordFlush(struct recorder *r, uint64_t now)
+{
+    recordWrite(r);
+    if (r->fd != -1 && fdatasync(r->fd) < 0 && errno != EINVAL)
+        fprintf(stderr, "Error. Unable to sync file %s: %s\n", r->name, strerror(errno));
+    r->flushed = now;
+}
+
+// Close the log, if any, and start the next one
+static void recordRotate(struct recorder *r, uint64_t now)
+{
+    if (r->fd != -1) {
+        recordFlush(r, now);
+        close(r->fd);
+    }
+
+    snprintf(r->name, sizeof(r->name), "%s-beast-bin-utc--%llu.%09llu--.log", r->prefix,
+             (long long unsigned) (now / 1000000000ULL), (long long unsigned) (now % 1000000000ULL));
+    r->fd = open(r->name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (r->fd == -1) {
+        fprintf(stderr, "Error. Unable to open for write file %s: %s\n", r->name, strerror(errno));
+        exit(1);
+    }
+    fprintf(stderr, "Record: writing %s\n", r->name);
+
+    r->opened = r->flushed = now;
+    r->synced = 0;
+    r->stats.files++;
+}
+
+static void recordPut(struct recorder *r, const char *p, int len)
+{
+    if (r->len + len > RECORD_BUFFER)
+        recordWrite(r);
+    memcpy(r->buf + r->len, p, len);
+    r->len += len;
+}
+
+static void recordSync(struct recorder *r, uint64_t now, uint64_t timestamp)
+{
+    unsigned char body[6 + 1 + BEAST_SYNC_BYTES];
+    char rec[2 + 2 * sizeof(body)];
+    int j, n = 0;
+
+    for (j = 0; j < 6; j++)
+        body[j] = timestamp >> (8 * (5 - j));
+    body[6] = 0;
+    for (j = 0; j < BEAST_SYNC_BYTES; j++)
+        body[7 + j] = now >> (8 * (BEAST_SYNC_BYTES - 1 - j));
+
+    rec[n++] = 0x1A;
+    rec[n++] = (char) BEAST_SYNC_TYPE;
+    for (j = 0; j < (int) sizeof(body); j++) {
+        rec[n++] = body[j];
+        if (body[j] == 0x1A)
+            rec[n++] = 0x1A;
+    }
+    recordPut(r, rec, n);
+
+    r->synced = now;
+    r->stats.syncs++;
+}
+
+struct recorder *recordOpen(const char *prefix, uint64_t sync_ns, uint64_t rotate_ns, uint64_t fsync_ns)
+{
+    struct recorder *r = calloc(1, sizeof(*r));
+
+    r->prefix = strdup(prefix);
+    r->sync_ns = sync_ns;
+    r->rotate_ns = rotate_ns;
+    r->fsync_ns = fsync_ns;
+    r->fd = -1;
+    r->buf = malloc(RECORD_BUFFER);
+    if (!r->buf) {
+        fprintf(stderr, "Error. Out of memory\n");
+        exit(1);
+    }
+    return r;
+}
+
+void recordFrame(struct recorder *r, char *frame, int len)
+{
+    uint64_t now = recordNow(), timestamp;
+
+    if (r->fd == -1 || (r->rotate_ns && now - r->opened >= r->rotate_ns))
+        recordRotate(r, now);
+
+    // Sync records of the feeder, if it was a recorder too, are kept as
+    // they are; ours go before a frame with a timestamp of its own, not
+    // one of those without clock or made up by multilateration
+    if ((unsigned char) frame[1] != BEAST_SYNC_TYPE && (!r->synced || now - r->synced >= r->sync_ns)) {
+        timestamp = frameTimestamp(frame);
+        if (timestamp && timestamp != MAGIC_MLAT_TIMESTAMP)
+            recordSync(r, now, timestamp);
+    }
+
+    recordPut(r, frame, len);
+    r->stats.frames++;
+
+    if (now - r->flushed >= r->fsync_ns)
+        recordFlush(r, now);
+}
+
+void recordIdle(struct recorder *r)
+{
+    uint64_t now;
+
+    if (!r->len)
+        return;
+    now = recordNow();
+    if (now - r->flushed >= r->fsync_ns)
+        recordFlush(r, now);
+}
+
+void recordPause(struct recorder *r)
+{
+    if (r->len)
+        recordFlush(r, recordNow());
+}
+
+void recordClose(struct recorder *r, struct recordstats *stats)
+{
+    if (r->fd != -1) {
+        recordFlush(r, recordNow());
+        close(r->fd);
+    }
+
+    *stats = r->stats;
+    free(r->buf);
+    free(r->prefix);
+    free(r);
+}
+
+void recordPrintStats(FILE *f, struct recordstats *s)
+{
+    fprintf(f, "Recorded %llu frames and %llu sync records in %llu logs, %llu bytes\n",
+           (long long unsigned) s->frames, (long long unsigned) s->syncs, (long long unsigned) s->files,
+           (long long unsigned) s->bytes);
+}
+
+void recordParseSync(char *frame, uint64_t *timestamp, uint64_t *unix_ns)
+{
+    unsigned char *p = (unsigned char *) frame + 2;
+    uint64_t v = 0;
+    int j;
+
+    // Timestamp, signal level, then the time, each byte escaped
+    for (j = 0; j < 6 + 1 + BEAST_SYNC_BYTES; j++) {
+        if (j == 6) {
+            *timestamp = v;
+            v = 0;
+        } else {
+            v = v << 8 | *p;
+        }
+        if (*p == 0x1A)
+            p++;
+        p++;
+    }
+    *unix_ns = v;
+}
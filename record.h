@@ -0,0 +1,67 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// record.h: logs of a feeder with wall clock sync records
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RECORD_H_INCLUDED
+#define RECORD_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Defaults of --record-sync (seconds), --record-rotate (minutes) and
+ * --record-fsync (seconds) */
+#define RECORD_SYNC_SEC     10
+#define RECORD_ROTATE_MIN   60
+#define RECORD_FSYNC_SEC    10
+
+/* Frames collected before a write */
+#define RECORD_BUFFER       (1024*1024)
+
+struct recorder;
+
+/* Counters of a recorder, left once it is closed */
+struct recordstats {
+    uint64_t frames;
+    uint64_t syncs;         // Sync records written
+    uint64_t files;
+    uint64_t bytes;
+};
+
+// Write the frames to "<prefix>-beast-bin-utc--<UNIX time>--.log", a new
+// one every rotate_ns (0 for never)
+struct recorder *recordOpen(const char *prefix, uint64_t sync_ns, uint64_t rotate_ns, uint64_t fsync_ns);
+
+// Add a frame (escaped BEAST) as it is received, after a sync record if
+// one is due
+void recordFrame(struct recorder *r, char *frame, int len);
+
+// Nothing to read for now: write what waits for longer than fsync_ns
+void recordIdle(struct recorder *r);
+
+// The feeder is gone for now: write and sync what is waiting
+void recordPause(struct recorder *r);
+
+// Write and sync what is left, close the log
+void recordClose(struct recorder *r, struct recordstats *stats);
+
+void recordPrintStats(FILE *f, struct recordstats *stats);
+
+// Read a sync record: receiver timestamp and UNIX time in nanoseconds
+void recordParseSync(char *frame, uint64_t *timestamp, uint64_t *unix_ns);
+
+#endif // RECORD_H_INCLUDED
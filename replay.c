@@ -0,0 +1,143 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// replay.c: network outputs at the pace of the log
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+//
+// A log served on the network (--replay-tcp to dump1090 --net-bi-port or
+// an mlat client, SBS on port 30003...) goes out as the receiver sent it:
+// every message at the time of its receiver timestamp, counted from the
+// first message and divided by --replay-speed. Most of a wait is spent
+// looking after the sockets, the end of it is slept with clock_nanosleep
+// on an absolute deadline so that errors don't add up; how late each
+// message went out is kept for the statistics.
+//
+// Messages from a feeder (--connect) or a growing file (--follow) already
+// come at that pace and are not held back.
+//
+
+static struct {
+    int      paced;             // Messages wait for their time
+    int      started;           // A message was paced, the times below are set
+    uint64_t base_ns;           // Monotonic time of the first message
+    uint64_t base_msg;          // And its receiver time
+    uint64_t last_msg;          // Latest receiver time so far
+
+    struct replaystats stats;
+} replay;
+
+static uint64_t replayNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Receiver time of a message in nanoseconds
+static uint64_t replayMsgTime(uint64_t timestamp)
+{
+    if (Modes.mlat_decoder == MLAT_BEAST)
+        return (timestamp >> 30) * 1000000000ULL + (timestamp & BEAST_DROP_UPPER_34_BITS);
+    return timestamp * 1000 / 12;
+}
+
+void replayStart(void)
+{
+    if (!netServers() || Modes.connect != NULL)
+        return;
+
+    // Nothing is replayed to nobody
+    fprintf(stderr, "Network: waiting for a client\n");
+    while (!netClients() && !Modes.exit)
+        netPoll(NET_POLL_MS);
+
+    replay.paced = (Modes.replay_speed > 0 && !Modes.follow);
+}
+
+void replayMessage(struct modesMessage *mm)
+{
+    uint64_t msg = replayMsgTime(mm->timestampMsg);
+    uint64_t deadline, now, late;
+
+    if (!replay.paced) {
+        netPoll(0);
+        return;
+    }
+
+    // Results of multilateration and frames without a clock have no time
+    // of their own, they go out at once
+    if (!mm->timestampMsg || mm->timestampMsg == MAGIC_MLAT_TIMESTAMP) {
+        replay.stats.frames++;
+        replay.stats.untimed++;
+        netPoll(0);
+        return;
+    }
+
+    // Start over when the receiver clock goes far back (new day, reset).
+    // Messages a bit out of order go out at once.
+    if (!replay.started || msg + REPLAY_RESTART_NS < replay.last_msg) {
+        replay.base_ns = replayNow();
+        replay.base_msg = replay.last_msg = msg;
+        replay.started = 1;
+    }
+    replay.stats.frames++;
+    if (msg < replay.last_msg) {
+        replay.stats.reordered++;
+        netPoll(0);
+        return;
+    }
+
+    replay.last_msg = msg;
+    deadline = replay.base_ns + (uint64_t) ((msg - replay.base_msg) / Modes.replay_speed);
+
+    while (!Modes.exit && (now = replayNow()) + REPLAY_SLEEP_NS < deadline)
+        netPoll((deadline - now - REPLAY_SLEEP_NS) / 1000000);
+
+    if (replayNow() < deadline) {
+        struct timespec ts;
+
+        ts.tv_sec = deadline / 1000000000ULL;
+        ts.tv_nsec = deadline % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+
+    now = replayNow();
+    late = (now > deadline) ? now - deadline : 0;
+    replay.stats.late_ns += late;
+    if (late > replay.stats.late_max_ns)
+        replay.stats.late_max_ns = late;
+    replay.stats.late[(late < 100000) ? 0 : (late < 1000000) ? 1 : (late < 10000000) ? 2 : 3]++;
+}
+
+void replayPrintStats(FILE *f)
+{
+    struct replaystats *s = &replay.stats;
+    double n = (s->frames > s->reordered + s->untimed) ? (double) (s->frames - s->reordered - s->untimed) : 1;
+
+    if (!s->frames)
+        return;
+    fprintf(f, "Replay timing: late by %.1f us on average, %.1f us at most; "
+           "%.1f%% within 100 us, %.1f%% within 1 ms, %.1f%% within 10 ms, %.1f%% later; "
+           "%llu messages out of order and %llu without a timestamp sent at once\n",
+           s->late_ns / n / 1000.0, s->late_max_ns / 1000.0,
+           100.0 * s->late[0] / n, 100.0 * s->late[1] / n, 100.0 * s->late[2] / n, 100.0 * s->late[3] / n,
+           (long long unsigned) s->reordered, (long long unsigned) s->untimed);
+}
@@ -0,0 +1,56 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// replay.h: network outputs at the pace of the log
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef REPLAY_H_INCLUDED
+#define REPLAY_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* The last part of a wait is slept with clock_nanosleep, before that the
+ * sockets are looked after */
+#define REPLAY_SLEEP_NS     2000000
+
+/* Going back in receiver time by more than this starts the pacing over */
+#define REPLAY_RESTART_NS   (10 * 1000000000ULL)
+
+struct modesMessage;
+
+/* How well the pacing went */
+struct replaystats {
+    uint64_t frames;        // Messages paced
+    uint64_t reordered;     // Messages older than one before them, sent at once
+    uint64_t untimed;       // Messages with a zero or MLAT timestamp, sent at once
+    uint64_t late_ns;       // Sum of the delays of the other messages sent after their time
+    uint64_t late_max_ns;
+    uint64_t late[4];       // Messages late by < 100 us, < 1 ms, < 10 ms, more
+};
+
+// With network outputs and a log for input, wait for the first client
+// and pace the messages from then on
+void replayStart(void);
+
+// Wait until the time of the receiver timestamp of the message, relative
+// to the first one and divided by --replay-speed, looking after the
+// sockets meanwhile
+void replayMessage(struct modesMessage *mm);
+
+void replayPrintStats(FILE *f);
+
+#endif // REPLAY_H_INCLUDED
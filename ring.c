@@ -0,0 +1,146 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// ring.c: single producer / single consumer queue between threads
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+static uint64_t elapsed_ns(const struct timespec *from)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) (now.tv_sec - from->tv_sec) * 1000000000ULL + now.tv_nsec - from->tv_nsec;
+}
+
+void ringInit(struct ring *r, unsigned size)
+{
+    unsigned n = 1;
+
+    while (n < size)
+        n <<= 1;
+
+    memset(r, 0, sizeof(*r));
+    r->slots = calloc(n, sizeof(void *));
+    r->size = n;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->waiters, 0);
+    atomic_init(&r->closed, 0);
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+}
+
+void ringDestroy(struct ring *r)
+{
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->cond);
+    free(r->slots);
+    r->slots = NULL;
+}
+
+// The sequentially consistent head/tail updates pair with the waiters
+// counter: either the sleeper sees the new index when it re-checks under
+// the lock, or the other side sees waiters != 0 and broadcasts.
+static void ringWake(struct ring *r)
+{
+    if (atomic_load(&r->waiters)) {
+        pthread_mutex_lock(&r->lock);
+        pthread_cond_broadcast(&r->cond);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+unsigned ringDepth(struct ring *r)
+{
+    return atomic_load(&r->head) - atomic_load(&r->tail);
+}
+
+int ringPush(struct ring *r, void *item)
+{
+    unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned depth;
+
+    if (head - atomic_load(&r->tail) == r->size) {
+        struct timespec start;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pthread_mutex_lock(&r->lock);
+        atomic_fetch_add(&r->waiters, 1);
+        while (head - atomic_load(&r->tail) == r->size && !atomic_load(&r->closed))
+            pthread_cond_wait(&r->cond, &r->lock);
+        atomic_fetch_sub(&r->waiters, 1);
+        pthread_mutex_unlock(&r->lock);
+        r->push_wait_ns += elapsed_ns(&start);
+    }
+
+    if (atomic_load(&r->closed))
+        return -1;
+
+    r->slots[head & (r->size - 1)] = item;
+    atomic_store(&r->head, head + 1);
+
+    depth = head + 1 - atomic_load(&r->tail);
+    if (depth > r->max_depth)
+        r->max_depth = depth;
+
+    ringWake(r);
+    return 0;
+}
+
+void *ringTryPop(struct ring *r)
+{
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    void *item;
+
+    if (tail == atomic_load(&r->head))
+        return NULL;
+
+    item = r->slots[tail & (r->size - 1)];
+    atomic_store(&r->tail, tail + 1);
+    ringWake(r);
+    return item;
+}
+
+void *ringPop(struct ring *r)
+{
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    if (tail == atomic_load(&r->head)) {
+        struct timespec start;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pthread_mutex_lock(&r->lock);
+        atomic_fetch_add(&r->waiters, 1);
+        while (tail == atomic_load(&r->head) && !atomic_load(&r->closed))
+            pthread_cond_wait(&r->cond, &r->lock);
+        atomic_fetch_sub(&r->waiters, 1);
+        pthread_mutex_unlock(&r->lock);
+        r->pop_wait_ns += elapsed_ns(&start);
+    }
+
+    // Closed rings still hand out what was queued before closing
+    return ringTryPop(r);
+}
+
+void ringClose(struct ring *r)
+{
+    pthread_mutex_lock(&r->lock);
+    atomic_store(&r->closed, 1);
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+}
@@ -0,0 +1,66 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// ring.h: single producer / single consumer queue between threads
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RING_H_INCLUDED
+#define RING_H_INCLUDED
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// A bounded queue of pointers with exactly one producer thread and one
+// consumer thread. Push and pop are lock-free while the ring is neither
+// full nor empty; a thread that has to wait sleeps on a condition variable
+// which the other side only touches when someone is actually waiting.
+struct ring {
+    void           **slots;
+    unsigned         size;        // power of two
+    atomic_uint      head;        // next slot to fill (producer)
+    atomic_uint      tail;        // next slot to drain (consumer)
+    atomic_int       waiters;     // threads sleeping in push or pop
+    atomic_int       closed;      // no more pushes, pop returns NULL once drained
+
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+
+    // Statistics, each written by one side only
+    uint64_t         push_wait_ns;    // producer time blocked on a full ring
+    uint64_t         pop_wait_ns;     // consumer time blocked on an empty ring
+    unsigned         max_depth;       // deepest queue seen by the producer
+};
+
+// size is rounded up to a power of two
+void  ringInit(struct ring *r, unsigned size);
+void  ringDestroy(struct ring *r);
+
+// Blocks while the ring is full. Returns -1 if the ring was closed.
+int   ringPush(struct ring *r, void *item);
+
+// Blocks while the ring is empty. Returns NULL when closed and drained.
+void *ringPop(struct ring *r);
+
+// Non-blocking pop, NULL if nothing is queued
+void *ringTryPop(struct ring *r);
+
+// Wake everyone up, further pushes fail
+void  ringClose(struct ring *r);
+
+unsigned ringDepth(struct ring *r);
+
+#endif // RING_H_INCLUDED
@@ -0,0 +1,101 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// simplify.c: streaming track simplification
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+#define EARTH_RADIUS 6371000.0   // metres
+#define FEET         0.3048
+
+void simplifyInit(struct simplifier *s, double tolerance) {
+    memset(s, 0, sizeof(*s));
+    s->tolerance = tolerance;
+}
+
+// Is q within tolerance of the segment a-b? Distances are taken on a flat
+// projection around a, which is plenty for the few kilometres in between.
+static int simplifyNear(const struct simplifier *s, const struct trackpoint *a,
+                        const struct trackpoint *b, const struct trackpoint *q) {
+    double kx = EARTH_RADIUS * M_PI / 180.0 * cos(a->lat * M_PI / 180.0);
+    double ky = EARTH_RADIUS * M_PI / 180.0;
+    double bx = (b->lon - a->lon) * kx, by = (b->lat - a->lat) * ky;
+    double qx = (q->lon - a->lon) * kx, qy = (q->lat - a->lat) * ky;
+    double len2 = bx * bx + by * by;
+    double t = 0, dx, dy, dz;
+
+    if (len2 > 0) {
+        t = (qx * bx + qy * by) / len2;
+        if (t < 0) t = 0;
+        if (t > 1) t = 1;
+    }
+    dx = qx - t * bx;
+    dy = qy - t * by;
+    dz = (q->alt - (a->alt + t * (b->alt - a->alt))) * FEET;
+
+    return (dx * dx + dy * dy <= s->tolerance * s->tolerance) && fabs(dz) <= s->tolerance;
+}
+
+// Keep the newest held point, it becomes the anchor
+static void simplifyKeepLast(struct simplifier *s, struct trackpoint *kept) {
+    s->anchor = s->window[s->n - 1];
+    *kept = s->anchor;
+    s->n = 0;
+    s->out++;
+}
+
+int simplifyAdd(struct simplifier *s, const struct trackpoint *p, struct trackpoint *kept) {
+    int j, ok;
+
+    s->in++;
+
+    if (s->tolerance <= 0 || !s->have_anchor) {
+        s->anchor = *p;
+        s->have_anchor = 1;
+        *kept = *p;
+        s->out++;
+        return 1;
+    }
+
+    if (s->n == 0) {
+        s->window[s->n++] = *p;
+        return 0;
+    }
+
+    ok = s->n < SIMPLIFY_WINDOW &&
+         p->time - s->window[s->n - 1].time <= SIMPLIFY_MAX_GAP &&
+         p->time - s->anchor.time <= SIMPLIFY_MAX_SPAN;
+
+    for (j = 0; ok && j < s->n; j++)
+        ok = simplifyNear(s, &s->anchor, p, &s->window[j]);
+
+    if (ok) {
+        s->window[s->n++] = *p;
+        return 0;
+    }
+
+    simplifyKeepLast(s, kept);
+    s->window[s->n++] = *p;
+    return 1;
+}
+
+int simplifyFlush(struct simplifier *s, struct trackpoint *kept) {
+    if (s->n == 0)
+        return 0;
+    simplifyKeepLast(s, kept);
+    return 1;
+}
@@ -0,0 +1,65 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// simplify.h: streaming track simplification prototypes
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SIMPLIFY_H_INCLUDED
+#define SIMPLIFY_H_INCLUDED
+
+#include <stdint.h>
+
+/* Points held back at most before one is kept anyway */
+#define SIMPLIFY_WINDOW   64
+
+/* A point is always kept before a gap in reception this long, in ms */
+#define SIMPLIFY_MAX_GAP  (10*1000)
+
+/* and at least one point kept this often, in ms */
+#define SIMPLIFY_MAX_SPAN (5*60*1000)
+
+/* One position of a track */
+struct trackpoint {
+    double   lon, lat;
+    int      alt;           // feet
+    int      speed;         // knots, -1 if not known
+    int      heading;       // degrees, -1 if not known
+    uint64_t time;          // message time, ms
+};
+
+// Opening window simplification: the last kept point is the anchor, and
+// the following points are held back as long as all of them lie within
+// the tolerance (horizontally and vertically) of the line from the anchor
+// to the newest one. When a new point breaks that, the point before it
+// is kept and becomes the anchor.
+struct simplifier {
+    double   tolerance;     // metres, 0 keeps every point
+    int      have_anchor;
+    struct trackpoint anchor;
+    struct trackpoint window[SIMPLIFY_WINDOW];
+    int      n;
+    uint64_t in, out;       // points given and kept
+};
+
+void simplifyInit(struct simplifier *s, double tolerance);
+
+// Give the next point. Returns 1 and sets *kept if a point is final now.
+int simplifyAdd(struct simplifier *s, const struct trackpoint *p, struct trackpoint *kept);
+
+// End of the track. Returns 1 and sets *kept if a point was held back.
+int simplifyFlush(struct simplifier *s, struct trackpoint *kept);
+
+#endif // SIMPLIFY_H_INCLUDED
@@ -0,0 +1,383 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// sink.c: output sinks, several outputs of the decoded stream in one pass
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "beastblackbox.h"
+
+static const struct {
+    const char   *name;
+    sink_format_t format;
+} sink_formats[] = {
+    { "sbs",      SINK_SBS },
+    { "verbose",  SINK_VERBOSE },
+    { "dump1090", SINK_VERBOSE },
+    { "json",     SINK_JSON },
+    { "kml",      SINK_KML },
+    { "kmz",      SINK_KML },
+    { "gxtrack",  SINK_GXTRACK },
+    { "geojson",  SINK_GEOJSON },
+    { "columns",  SINK_COLUMNS },
+    { "beast",    SINK_BEAST },
+    { "extract",  SINK_BEAST },
+    { "replay",   SINK_BEAST },
+    { "blackbox", SINK_BLACKBOX },
+    { NULL,       0 }
+};
+
+static struct sink *sinkNew(sink_format_t format, const char *path) {
+    struct sink *s;
+
+    if (Modes.nsinks == MAX_SINKS) {
+        fprintf(stderr, "Error. Too many outputs, at most %d are supported\n", MAX_SINKS);
+        exit(1);
+    }
+
+    s = &Modes.sinks[Modes.nsinks++];
+    memset(s, 0, sizeof(*s));
+    s->format = format;
+    s->path = strdup(path);
+    s->filter_df = -1;
+    s->simplify = -1;
+    s->prev_timestamp = &s->own_prev;
+    s->policy = -1;
+    return s;
+}
+
+// A replay is a BEAST output served on the port of localhost
+static void sinkReplay(struct sink *s, const char *port) {
+    free(s->path);
+    s->path = malloc(strlen(port) + 15);
+    sprintf(s->path, "tcp:127.0.0.1:%s", port);
+}
+
+void sinkAdd(const char *spec) {
+    char *copy = strdup(spec);
+    char *colon = strchr(copy, ':');
+    char *path, *opt, *next;
+    struct sink *s;
+    int j;
+
+    if (!colon || colon[1] == '\0') {
+        fprintf(stderr, "Error. Output must be given as <format>:<path>, got '%s'\n", spec);
+        exit(1);
+    }
+    *colon = '\0';
+    path = colon + 1;
+
+    for (j = 0; sink_formats[j].name; j++) {
+        if (!strcmp(copy, sink_formats[j].name))
+            break;
+    }
+    if (!sink_formats[j].name) {
+        fprintf(stderr, "Error. Unknown output format '%s'\n", copy);
+        exit(1);
+    }
+
+    // Options follow the path, separated by commas
+    opt = strchr(path, ',');
+    if (opt)
+        *opt++ = '\0';
+
+    s = sinkNew(sink_formats[j].format, path);
+    if (!strcmp(copy, "kmz"))
+        s->kmz = 1;
+    if (!strcmp(copy, "replay"))
+        sinkReplay(s, path);
+
+    for (; opt; opt = next) {
+        next = strchr(opt, ',');
+        if (next)
+            *next++ = '\0';
+
+        if (!strncmp(opt, "icao=", 5)) {
+            s->filter_icao = (uint32_t) strtoul(opt + 5, NULL, 16);
+        } else if (!strncmp(opt, "df=", 3)) {
+            s->filter_df = atoi(opt + 3);
+        } else if (!strncmp(opt, "simplify=", 9)) {
+            s->simplify = atof(opt + 9);
+        } else if (!strncmp(opt, "policy=", 7)) {
+            s->policy = netPolicy(opt + 7);
+            if (s->policy < 0) {
+                fprintf(stderr, "Error. Unknown policy '%s' of output %s, use drop, disconnect or block\n", opt + 7, spec);
+                exit(1);
+            }
+        } else {
+            fprintf(stderr, "Error. Unknown option '%s' of output %s\n", opt, spec);
+            exit(1);
+        }
+    }
+
+    free(copy);
+}
+
+void sinkOpenAll(void) {
+    struct sink *s;
+    int j;
+
+    // The classic options are outputs like any other
+    if (!Modes.quiet && !Modes.find_icao) {
+        s = sinkNew(Modes.sbs_output ? SINK_SBS : Modes.json_output ? SINK_JSON : SINK_VERBOSE, "-");
+        s->prev_timestamp = &Modes.previoustimestampMsg;
+    }
+    if (Modes.filename_extract != NULL)
+        sinkNew(SINK_BEAST, Modes.filename_extract);
+    if (Modes.filename_kml != NULL)
+        sinkNew(SINK_KML, Modes.filename_kml);
+    if (Modes.replay_port != NULL)
+        sinkReplay(sinkNew(SINK_BEAST, ""), Modes.replay_port);
+    if (Modes.net_sbs_port != NULL) {
+        char *path = malloc(strlen(Modes.net_sbs_port) + 5);
+        sprintf(path, "tcp:%s", Modes.net_sbs_port);
+        sinkNew(SINK_SBS, path);
+        free(path);
+    }
+    if (Modes.blackbox != NULL)
+        sinkNew(SINK_BLACKBOX, Modes.blackbox);
+
+    for (j = 0; j < Modes.nsinks; j++) {
+        s = &Modes.sinks[j];
+
+        // With --batch the names are added to the name of the log
+        if (Modes.batch_input) {
+            char *path = malloc(strlen(Modes.batch_input) + strlen(s->path) + 1);
+            sprintf(path, "%s%s", Modes.batch_input, s->path);
+            free(s->path);
+            s->path = path;
+        }
+
+        if (!s->filter_icao)
+            s->filter_icao = Modes.show_only;
+
+        if (s->simplify < 0)
+            s->simplify = Modes.simplify;
+
+        if (s->format == SINK_KML || s->format == SINK_GXTRACK) {
+            size_t len = strlen(s->path);
+            if (len > 4 && !strcasecmp(s->path + len - 4, ".kmz"))
+                s->kmz = 1;
+        }
+
+        if (s->format == SINK_BLACKBOX) {
+            s->bb = blackboxOpen(s->path, (uint64_t) (Modes.blackbox_before * 60000),
+                                 (uint64_t) (Modes.blackbox_after * 60000),
+                                 (size_t) Modes.blackbox_size << 20, Modes.blackbox_triggers);
+            continue;
+        }
+
+        if (!strncmp(s->path, "tcp:", 4)) {
+            // Frames go to a feed of BEAST like a replay, clients of
+            // anything else aren't worth slowing down for
+            if (s->policy < 0)
+                s->policy = (s->format == SINK_BEAST) ? Modes.replay_policy : NET_DISCONNECT;
+            s->net = netOpen(s->path + 4, s->policy);
+            netOutInit(&s->buf, s->net);
+            s->out = &s->buf;
+        } else if (!strcmp(s->path, "-")) {
+            s->out = &Modes.out;
+        } else {
+            s->f = fopen(s->path, (s->format == SINK_BEAST || s->format == SINK_COLUMNS || s->kmz) ? "wb" : "w");
+            if (s->f == NULL) {
+                fprintf(stderr, "Error. Unable to open for write file %s\n", s->path);
+                exit(1);
+            }
+            if (s->kmz)
+                s->f = kmzOpen(s->f);
+            outInit(&s->buf, s->f);
+            s->out = &s->buf;
+        }
+
+        if (s->format == SINK_KML)
+            s->kml = kmlOpen(s->out, KML_LINE, s->filter_icao, s->simplify);
+        else if (s->format == SINK_GXTRACK)
+            s->kml = kmlOpen(s->out, KML_GXTRACK, s->filter_icao, s->simplify);
+        else if (s->format == SINK_GEOJSON)
+            s->kml = kmlOpen(s->out, KML_GEOJSON, s->filter_icao, s->simplify);
+        else if (s->format == SINK_COLUMNS)
+            s->cols = colOpen(s->out);
+    }
+
+    replayStart();
+}
+
+void sinkFrame(char *frame, int len) {
+    int j;
+
+    for (j = 0; j < Modes.nsinks; j++)
+        if (Modes.sinks[j].format == SINK_BLACKBOX)
+            blackboxFrame(Modes.sinks[j].bb, frame, len);
+}
+
+void sinkMessage(struct modesMessage *mm, char *frame, int len) {
+    struct sink *s;
+    char *p;
+    int j;
+
+    if (netServers())
+        replayMessage(mm);
+
+    for (j = 0; j < Modes.nsinks; j++) {
+        s = &Modes.sinks[j];
+
+        // The black box has all the frames already, whatever the filters
+        if (s->format == SINK_BLACKBOX) {
+            blackboxMessage(s->bb, mm);
+            continue;
+        }
+
+        if (s->filter_icao && mm->addr != s->filter_icao)
+            continue;
+        if (s->filter_df >= 0 && mm->msgtype != s->filter_df)
+            continue;
+
+        switch (s->format) {
+        case SINK_SBS:
+            modesSendSBSOutput(s->out, mm);
+            break;
+
+        case SINK_VERBOSE:
+            if (!*s->prev_timestamp)
+                *s->prev_timestamp = Modes.inputs[mm->input].clock.first;
+            displayModesMessage(s->out, mm, *s->prev_timestamp);
+            if (mm->timestampMsg) *s->prev_timestamp = mm->timestampMsg;
+            break;
+
+        case SINK_JSON:
+            jsonModesMessage(s->out, mm);
+            break;
+
+        case SINK_KML:
+        case SINK_GXTRACK:
+        case SINK_GEOJSON:
+            kmlAddMessage(s->kml, mm);
+            break;
+
+        case SINK_COLUMNS:
+            colAddMessage(s->cols, mm);
+            break;
+
+        case SINK_BEAST:
+            p = outReserve(s->out, len);
+            memcpy(p, frame, len);
+            outCommit(s->out, p + len);
+            if (!s->net)
+                Modes.msg_extracted++;
+            break;
+
+        default:
+            break;
+        }
+        if (s->net)
+            netOutPublish(s->out);
+        s->messages++;
+    }
+}
+
+// Without the writer thread the data is still in stdio buffers after that
+static void sinkFlush(struct outbuf *o) {
+    outFlush(o);
+    if (!o->chunk)
+        fflush(o->f);
+}
+
+void sinkFlushAll(void) {
+    int j;
+
+    sinkFlush(&Modes.out);
+    for (j = 0; j < Modes.nsinks; j++) {
+        if (Modes.sinks[j].f)
+            sinkFlush(&Modes.sinks[j].buf);
+        if (Modes.sinks[j].bb)
+            blackboxFlush(Modes.sinks[j].bb);
+    }
+    netPoll(0);
+}
+
+void sinkFinishAll(void) {
+    struct sink *s;
+    int j;
+
+    for (j = 0; j < Modes.nsinks; j++) {
+        s = &Modes.sinks[j];
+        if (s->kml) {
+            kmlClose(s->kml, &s->points_in, &s->points_out);
+            s->kml = NULL;
+        }
+        if (s->cols) {
+            colClose(s->cols);
+            s->cols = NULL;
+        }
+        if (s->bb) {
+            blackboxClose(s->bb, &s->bb_stats);
+            s->bb = NULL;
+        }
+        if (s->f)
+            outFree(&s->buf);
+        if (s->net) {
+            outFree(&s->buf);
+            netClose(s->net, &s->net_stats);
+            s->net = NULL;
+        }
+    }
+}
+
+void sinkCloseAll(void) {
+    struct sink *s;
+    int j;
+
+    for (j = 0; j < Modes.nsinks; j++) {
+        s = &Modes.sinks[j];
+        if (s->f && fclose(s->f) != 0)
+            fprintf(stderr, "Error. Write error in file %s\n", s->path);
+        s->f = NULL;
+    }
+}
+
+static const char *sinkFormatName(struct sink *s) {
+    int j;
+
+    for (j = 0; sink_formats[j].name && sink_formats[j].format != s->format; j++)
+        ;
+    return sink_formats[j].name;
+}
+
+int sinkJsonOnStdout(void) {
+    int j;
+
+    for (j = 0; j < Modes.nsinks; j++)
+        if (Modes.sinks[j].format == SINK_JSON && !strcmp(Modes.sinks[j].path, "-"))
+            return 1;
+    return 0;
+}
+
+void sinkPrintStats(FILE *f) {
+    struct sink *s;
+    int j;
+
+    for (j = 0; j < Modes.nsinks; j++) {
+        s = &Modes.sinks[j];
+        if (s->net_stats.port)
+            netPrintStats(f, sinkFormatName(s), &s->net_stats);
+        if (s->format == SINK_BLACKBOX)
+            blackboxPrintStats(f, s->path, &s->bb_stats);
+        if ((s->format != SINK_KML && s->format != SINK_GXTRACK && s->format != SINK_GEOJSON) || !s->simplify)
+            continue;
+        fprintf(f, "Track %s: %llu points in, %llu out (tolerance %g m)\n", s->path,
+               (long long unsigned) s->points_in, (long long unsigned) s->points_out, s->simplify);
+    }
+    replayPrintStats(f);
+}
@@ -0,0 +1,94 @@
+// Part of BEAST black box utility, a Mode S message BEAST decoder from file
+//
+// sink.h: output sinks prototypes
+//
+// Copyright (c) 2018 Denis G Dugushkin <dentall@mail.ru>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SINK_H_INCLUDED
+#define SINK_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include "netout.h"
+#include "blackbox.h"
+
+/* Most outputs fed in one pass */
+#define MAX_SINKS 16
+
+/* Output formats */
+typedef enum {
+    SINK_SBS, SINK_VERBOSE, SINK_JSON, SINK_KML, SINK_GXTRACK, SINK_GEOJSON, SINK_COLUMNS, SINK_BEAST, SINK_BLACKBOX
+} sink_format_t;
+
+struct modesMessage;
+
+/* One output of the decoded stream: stdout, --extract, --export-kml, --replay-tcp, --net-sbs-port, --blackbox or --output */
+struct sink {
+    sink_format_t  format;
+    char          *path;         // File name, "-" is stdout, "tcp:[address:]port" a server
+    FILE          *f;
+    struct outbuf  buf;          // Buffer of a file output
+    struct outbuf *out;          // buf, or Modes.out for stdout
+
+    uint32_t       filter_icao;  // Only messages from this address, 0 for --filter-icao
+    int            filter_df;    // Only this downlink format, -1 for all
+
+    int            kmz;          // KML or gx:Track output zipped as KMZ
+    struct kmlexport *kml;       // Track export state
+    struct colexport *cols;      // Columnar export state
+    double         simplify;     // Track tolerance in metres, -1 for --simplify
+    uint64_t       points_in;    // Track points before and after simplification
+    uint64_t       points_out;
+
+    struct netserver *net;       // Server of a "tcp:" output
+    struct netstats net_stats;
+    int            policy;       // net_policy_t for a client which doesn't keep up, -1 for the default
+
+    struct blackbox *bb;         // Recorder of a black box output (the path is the directory)
+    struct blackboxstats bb_stats;
+
+    uint64_t      *prev_timestamp; // Last message shown, for relative time in verbose output
+    uint64_t       own_prev;
+    long long unsigned messages; // Messages written
+};
+
+// Add a sink from "<format>:<path>[,icao=<addr>][,df=<n>][,policy=<p>]", exits on error
+void sinkAdd(const char *spec);
+
+// Add the sinks asked for by the classic options, then open all of them
+void sinkOpenAll(void);
+
+// Pass a frame to the black boxes as it is read, before decoding
+void sinkFrame(char *frame, int len);
+
+// Pass a decoded message (and its escaped BEAST frame) to every sink
+void sinkMessage(struct modesMessage *mm, char *frame, int len);
+
+// Hand buffered output over for writing (end of available input)
+void sinkFlushAll(void);
+
+// Write what is left, then close the files once the writer thread is done
+void sinkFinishAll(void);
+void sinkCloseAll(void);
+
+// Does one of the outputs write JSON to stdout
+int  sinkJsonOnStdout(void);
+
+// Print points in/out of the track outputs, how the network outputs went
+// and what the black boxes recorded
+void sinkPrintStats(FILE *f);
+
+#endif // SINK_H_INCLUDED
@@ -94,6 +94,20 @@ struct aircraft *trackCreateAircraft(struct modesMessage *mm) {
     return (a);
 }
 
+//
+//=========================================================================
+//
+// Aircraft are spread over Modes.tracker_threads tables by address, so
+// that each table can be updated by its own thread (see pipeline.c). All
+// the state of an aircraft is in its own record, so the result is the same
+// whatever the number of tables.
+//
+int trackShard(uint32_t addr) {
+    // Low bits of ICAO addresses are well spread, but not those of the
+    // Mode A/C and non-ICAO ones
+    return ((addr * 0x9E3779B1U) >> 16) % Modes.tracker_threads;
+}
+
 //
 //=========================================================================
 //
@@ -101,7 +115,7 @@ struct aircraft *trackCreateAircraft(struct modesMessage *mm) {
 // exists with this address.
 //
 struct aircraft *trackFindAircraft(uint32_t addr) {
-    struct aircraft *a = Modes.aircrafts;
+    struct aircraft *a = Modes.aircrafts[trackShard(addr)];
 
     while(a) {
         if (a->addr == addr) return (a);
@@ -183,7 +197,7 @@ static double greatcircle(double lat0, double lon0, double lat1, double lon1)
     // spherical law of cosines
     return 6371e3 * acos(sin(lat0) * sin(lat1) + cos(lat0) * cos(lat1) * cos(dlon));
 }
-
+
 /*
 static void update_range_histogram(double lat, double lon)
 {
@@ -198,7 +212,7 @@ static void update_range_histogram(double lat, double lon)
 
         //++Modes.stats_current.range_histogram[bucket];
     }
-}
+}
 */
 
 /*
@@ -535,9 +549,10 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
     // Lookup our aircraft or create a new one
     a = trackFindAircraft(mm->addr);
     if (!a) {                              // If it's a currently unknown aircraft....
+        int shard = trackShard(mm->addr);
         a = trackCreateAircraft(mm);       // ., create a new record for it,
-        a->next = Modes.aircrafts;         // .. and put it at the head of the list
-        Modes.aircrafts = a;
+        a->next = Modes.aircrafts[shard];  // .. and put it at the head of its list
+        Modes.aircrafts[shard] = a;
     }
 
     if (mm->signalLevel > 0) {
@@ -664,6 +679,16 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
         }
     }
 
+    // What the outputs need to know about the aircraft
+    mm->aircraft.gnss_delta_valid = trackDataValid(&a->gnss_delta_valid);
+    mm->aircraft.gnss_delta = a->gnss_delta;
+    mm->aircraft.callsign_valid = trackDataValid(&a->callsign_valid) && a->callsign[0];
+    memcpy(mm->aircraft.callsign, a->callsign, sizeof(a->callsign));
+    mm->aircraft.speed_valid = trackDataValid(&a->speed_valid);
+    mm->aircraft.speed = a->speed;
+    mm->aircraft.heading_valid = trackDataValid(&a->heading_valid);
+    mm->aircraft.heading = a->heading;
+
     return (a);
 }
 
@@ -694,10 +719,10 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
 // Note : It's theoretically possible for an aircraft to have the same value for Mode A
 // and Mode C. Therefore we have to check BOTH A AND C for EVERY S.
 //
-static void trackUpdateAircraftModeA(struct aircraft *a)
+// b is the list of one of the aircraft tables.
+//
+static void trackUpdateAircraftModeA(struct aircraft *a, struct aircraft *b)
 {
-    struct aircraft *b = Modes.aircrafts;
-
     while(b) {
         if ((b->modeACflags & MODEAC_MSG_FLAG) == 0) {  // skip any fudged ICAO records
 
@@ -738,18 +763,22 @@ static void trackUpdateAircraftModeA(struct aircraft *a)
 //
 static void trackUpdateAircraftModeS()
 {
-    struct aircraft *a = Modes.aircrafts;
+    struct aircraft *a;
+    int shard, other;
 
-    while(a) {
-        int flags = a->modeACflags;
-        if (flags & MODEAC_MSG_FLAG) { // find any fudged ICAO records
+    for (shard = 0; shard < Modes.tracker_threads; shard++) {
+        for (a = Modes.aircrafts[shard]; a; a = a->next) {
+            int flags = a->modeACflags;
+            if (flags & MODEAC_MSG_FLAG) { // find any fudged ICAO records
 
-            // clear the current A,C and S hit bits ready for this attempt
-            a->modeACflags = flags & ~(MODEAC_MSG_MODEA_HIT | MODEAC_MSG_MODEC_HIT | MODEAC_MSG_MODES_HIT);
+                // clear the current A,C and S hit bits ready for this attempt
+                a->modeACflags = flags & ~(MODEAC_MSG_MODEA_HIT | MODEAC_MSG_MODEC_HIT | MODEAC_MSG_MODES_HIT);
 
-            trackUpdateAircraftModeA(a);  // and attempt to match them with Mode-S
+                // and attempt to match them with Mode-S, in every table
+                for (other = 0; other < Modes.tracker_threads; other++)
+                    trackUpdateAircraftModeA(a, Modes.aircrafts[other]);
+            }
         }
-        a = a->next;
     }
 }
 
@@ -759,9 +788,9 @@ static void trackUpdateAircraftModeS()
 // If we don't receive new nessages within TRACK_AIRCRAFT_TTL
 // we remove the aircraft from the list.
 //
-static void trackRemoveStaleAircraft(uint64_t now)
+static void trackRemoveStaleAircraft(int shard, uint64_t now)
 {
-    struct aircraft *a = Modes.aircrafts;
+    struct aircraft *a = Modes.aircrafts[shard];
     struct aircraft *prev = NULL;
 
     while(a) {
@@ -775,7 +804,7 @@ static void trackRemoveStaleAircraft(uint64_t now)
             // Remove the element from the linked list, with care
             // if we are removing the first element
             if (!prev) {
-                Modes.aircrafts = a->next; free(a); a = Modes.aircrafts;
+                Modes.aircrafts[shard] = a->next; free(a); a = Modes.aircrafts[shard];
             } else {
                 prev->next = a->next; free(a); a = prev->next;
             }
@@ -806,18 +835,136 @@ static void trackRemoveStaleAircraft(uint64_t now)
 
 
 //
-// Entry point for periodic updates
+// Entry points for periodic updates. Each table is expired on its own,
+// by the thread that updates it; the Mode A/C matching looks at all of
+// them, so it is done when none is being updated.
 //
 
-void trackPeriodicUpdate()
+void trackExpire(int shard)
 {
-    static uint64_t next_update;
+    static uint64_t next_update[MAX_TRACKER_THREADS];
     uint64_t now = mstime();
 
     // Only do updates once per second
+    if (now >= next_update[shard]) {
+        next_update[shard] = now + 1000;
+        trackRemoveStaleAircraft(shard, now);
+    }
+}
+
+void trackCorrelate()
+{
+    static uint64_t next_update;
+    uint64_t now = mstime();
+
     if (now >= next_update) {
         next_update = now + 1000;
-        trackRemoveStaleAircraft(now);
         trackUpdateAircraftModeS();
     }
 }
+
+void trackPeriodicUpdate()
+{
+    int shard;
+
+    for (shard = 0; shard < Modes.tracker_threads; shard++)
+        trackExpire(shard);
+    trackCorrelate();
+}
+
+//
+//=========================================================================
+//
+// Checkpoint support. Aircraft are written as raw structures, so a
+// checkpoint is only valid for the same build (checked by the caller).
+// Tracker times are wall clock millis; on load they are shifted by the
+// time elapsed since the save so that ages carry on from where they were.
+//
+
+int trackSaveState(FILE *f)
+{
+    struct aircraft *a;
+    uint32_t count = 0;
+    uint64_t now = mstime();
+    int shard;
+
+    for (shard = 0; shard < Modes.tracker_threads; shard++)
+        for (a = Modes.aircrafts[shard]; a; a = a->next)
+            count++;
+
+    if (fwrite(&now, sizeof(now), 1, f) != 1 || fwrite(&count, sizeof(count), 1, f) != 1)
+        return -1;
+
+    for (shard = 0; shard < Modes.tracker_threads; shard++) {
+        for (a = Modes.aircrafts[shard]; a; a = a->next) {
+            if (fwrite(a, sizeof(*a), 1, f) != 1)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static void shift_validity(data_validity *d, int64_t delta)
+{
+    if (d->source == SOURCE_INVALID)
+        return;
+    d->updated += delta;
+    d->stale += delta;
+    d->expires += delta;
+}
+
+int trackLoadState(FILE *f)
+{
+    struct aircraft **tail[MAX_TRACKER_THREADS];
+    uint64_t saved;
+    uint32_t count, i;
+    int64_t delta;
+    int shard;
+
+    if (fread(&saved, sizeof(saved), 1, f) != 1 || fread(&count, sizeof(count), 1, f) != 1)
+        return -1;
+
+    delta = (int64_t) (mstime() - saved);
+
+    // The checkpoint may have been saved with another number of tables
+    for (i = 0; i < (uint32_t) Modes.tracker_threads; ++i)
+        tail[i] = &Modes.aircrafts[i];
+
+    for (i = 0; i < count; ++i) {
+        struct aircraft *a = malloc(sizeof(*a));
+        if (!a || fread(a, sizeof(*a), 1, f) != 1) {
+            free(a);
+            return -1;
+        }
+
+        a->seen += delta;
+        if (a->fatsv_last_emitted)
+            a->fatsv_last_emitted += delta;
+
+#define SHIFT(_f) shift_validity(&a->_f##_valid, delta)
+        SHIFT(callsign);
+        SHIFT(altitude);
+        SHIFT(altitude_gnss);
+        SHIFT(gnss_delta);
+        SHIFT(speed);
+        SHIFT(speed_ias);
+        SHIFT(speed_tas);
+        SHIFT(heading);
+        SHIFT(heading_magnetic);
+        SHIFT(vert_rate);
+        SHIFT(squawk);
+        SHIFT(category);
+        SHIFT(airground);
+        SHIFT(cpr_odd);
+        SHIFT(cpr_even);
+        SHIFT(position);
+#undef SHIFT
+
+        // Keep the saved list order
+        shard = trackShard(a->addr);
+        a->next = NULL;
+        *tail[shard] = a;
+        tail[shard] = &a->next;
+    }
+    return 0;
+}
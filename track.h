@@ -197,7 +197,24 @@ static inline uint64_t trackDataAge(const data_validity *v,
 struct modesMessage;
 struct aircraft *trackUpdateFromMessage(struct modesMessage *mm);
 
-/* Call periodically */
+/* Return the aircraft with the given address, or NULL */
+struct aircraft *trackFindAircraft(uint32_t addr);
+
+/* Table (and tracker thread) an address belongs to */
+int trackShard(uint32_t addr);
+
+/* Call periodically: trackExpire() for each table, by the thread that
+ * updates it, and trackCorrelate() while no table is being updated.
+ * trackPeriodicUpdate() does both for all tables.
+ */
+void trackExpire(int shard);
+void trackCorrelate();
 void trackPeriodicUpdate();
 
+/* Save/restore the tracked aircraft (--checkpoint).
+ * Return 0 on success, -1 on I/O error.
+ */
+int trackSaveState(FILE *f);
+int trackLoadState(FILE *f);
+
 #endif
@@ -100,15 +100,6 @@ int time_offset()
 }
 
 
-void MLATtime_none(struct timespec *msgTime, uint64_t mlatTimestamp) {
-
-	msgTime->tv_nsec = mlatTimestamp; // Just to avoid compiler warning that "mlatTimestamp" never used
-    // Find current system time
-    clock_gettime(CLOCK_REALTIME, msgTime);
-
-}
-
-
 /*	The GPS timestamp is completely handled in the FPGA (hardware) and does not require any interactions on the Linux side.
 	This is essential to meet the required accuracy. The local clock in the FPGA (64MHz or 96MHz) is stretched or compressed
 	to meet 1e9 counts in between two pulses by a linear algorithm, in order to avoid bigger jumps in the timestamp.
@@ -121,29 +112,110 @@ void MLATtime_none(struct timespec *msgTime, uint64_t mlatTimestamp) {
 */
 
 
-void MLATtime_beast(struct timespec *msgTime, uint64_t mlatTimestamp) {
+// Seconds of day of the last message: a step back of more than half a day
+// is midnight, a step forward as big a message of the day before, late.
+// The first message tells which midnight the start time belongs to: the
+// one nearest to the start time minus the seconds of day, as for a sync
+// record.
+static uint64_t mlatBeast(struct mlatclock *c, uint64_t mlatTimestamp) {
+
+	int64_t second = mlatTimestamp >> 30;
+	uint64_t day_ns = second * 1000000000ULL + (mlatTimestamp & BEAST_DROP_UPPER_34_BITS);
+	uint64_t day = c->base_ns;
+
+	if (c->start) {
+		c->base_ns = day = (c->base_ns - day_ns + 43200ULL * 1000000000ULL) / (86400ULL * 1000000000ULL) * (86400ULL * 1000000000ULL);
+		c->start = 0;
+		c->last_second = second;
+	} else if (second + 43200 < c->last_second) {
+		day = c->base_ns += 86400ULL * 1000000000ULL;
+		c->last_second = second;
+	} else if (second > c->last_second + 43200 && c->last_second >= 0) {
+		if (day >= 86400ULL * 1000000000ULL)
+			day -= 86400ULL * 1000000000ULL;
+	} else {
+		c->last_second = second;
+	}
+	return day + day_ns;
+}
+
 
-	msgTime->tv_sec = Modes.baseTime.tv_sec + (mlatTimestamp >> 30);
-	msgTime->tv_nsec = mlatTimestamp & BEAST_DROP_UPPER_34_BITS;
+/*	dump1090 counts 12MHz ticks from its start, in 48 bits which wrap after 271 days.
+	The time of a message is base_ns plus the ticks since base_timestamp (a signed
+	48 bit difference, so a message a bit older than the base and the counter wrapping
+	are right) times rate, ns per tick as 32.32 fixed point. Integers only, and
+	no divide but the one by a constant to split seconds, which is a multiply.
+*/
+static uint64_t mlatDump1090(struct mlatclock *c, uint64_t mlatTimestamp) {
+
+	int64_t ticks = (int64_t) ((mlatTimestamp - c->base_timestamp) << 16) >> 16;
+	uint64_t n = (ticks < 0) ? (uint64_t) -ticks : (uint64_t) ticks;
+	uint64_t rate_frac = c->rate & 0xFFFFFFFF, ns;
+
+	// n * rate >> 32 without overflow: n < 2^48, rate < 2^39
+	ns = n * (c->rate >> 32) + (n >> 32) * rate_frac + (((n & 0xFFFFFFFF) * rate_frac) >> 32);
+	return (ticks < 0) ? c->base_ns - ns : c->base_ns + ns;
 }
 
+void signalsBlock(sigset_t *old) {
 
-void MLATtime_dump1090(struct timespec *msgTime, uint64_t mlatTimestamp) {
+	sigset_t block;
 
-	uint64_t mlat_realtime;
+	sigemptyset(&block);
+	sigaddset(&block, SIGINT);
+	sigaddset(&block, SIGTERM);
+	sigaddset(&block, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &block, old);
+}
 
+//
+// Time base: --init-time-unix, or the time in the name of the log
+//
+int timeParse(const char *s, struct timespec *ts) {
+
+	const char *p = s;
+	uint64_t sec = 0, nsec = 0, scale = 100000000;
+
+	while (*p >= '0' && *p <= '9')
+		sec = sec * 10 + (*p++ - '0');
+	if (p == s)
+		return 0;
+	if (*p == '.') {
+		for (p++; *p >= '0' && *p <= '9'; p++) {
+			nsec += (*p - '0') * scale;
+			scale /= 10;
+		}
+	}
+	ts->tv_sec = (time_t) sec;
+	ts->tv_nsec = (long) nsec;
+	return (int) (p - s);
+}
+
+int timeFromFilename(const char *filename, struct timespec *ts) {
 
-	msgTime->tv_nsec = Modes.baseTime.tv_nsec;
-	msgTime->tv_sec = Modes.baseTime.tv_sec;
+	const char *p = strrchr(filename, '/');
+	int len;
+
+	// Our logs are named "...--<seconds>.<nanoseconds>--..."
+	for (p = p ? p : filename; (p = strstr(p, "--")) != NULL; p++) {
+		len = timeParse(p + 2, ts);
+		if (len && p[2 + len - 1] != '.' && !strncmp(p + 2 + len, "--", 2))
+			return 1;
+	}
+	return 0;
+}
 
-	mlat_realtime = (mlatTimestamp - Modes.firsttimestampMsg) / 12;
-	msgTime->tv_nsec += 1000 * (mlat_realtime % 1000000);
+void mlatClockInit(struct mlatclock *c, const struct timespec *start) {
 
-	if (msgTime->tv_nsec > 999999999) {
-		msgTime->tv_sec++;
-		msgTime->tv_nsec -= 999999999;
+	memset(c, 0, sizeof(*c));
+	c->rate = DUMP1090_NS_PER_TICK;
+	c->last_second = -1;
+	if (start && (start->tv_sec || start->tv_nsec)) {
+		c->based = 1;
+		c->base_ns = (uint64_t) start->tv_sec * 1000000000ULL + start->tv_nsec;
+		// The day of a beast clock is only known along with a seconds of day
+		c->start = (Modes.mlat_decoder == MLAT_BEAST);
 	}
-	msgTime->tv_sec += mlat_realtime / 1000000;
 }
 
 /*
@@ -155,17 +227,14 @@ addMLATtime(&mm.sysTimestampMsg, (mm.timestampMsg - Modes.firsttimestampMsg));
 //
 // Write SBS output
 //
-static void modesSendSBSOutput(struct modesMessage *mm) {
+void modesSendSBSOutput(struct outbuf *o, struct modesMessage *mm) {
+    static struct outdate receive_date, now_date;
+    static struct timespec now;
     char *p;
-	char buffer[200];
-    struct timespec now;
-    struct tm    stTime_receive, stTime_now;
     int          msgType;
-	p = &buffer[0];
-	struct aircraft *a = Modes.aircrafts;
 
     // For now, suppress non-ICAO addresses
-    if ((mm->addr & MODES_NON_ICAO_ADDRESS) || !(!Modes.show_only || mm->addr == Modes.show_only))
+    if (mm->addr & MODES_NON_ICAO_ADDRESS)
         return;
 
     //
@@ -179,7 +248,6 @@ static void modesSendSBSOutput(struct modesMessage *mm) {
     case 20:
         msgType = 5;
         break;
-        break;
 
     case 5:
     case 21:
@@ -214,137 +282,114 @@ static void modesSendSBSOutput(struct modesMessage *mm) {
         return;
     }
 
+    // The line is formatted in place, at the end of the output buffer
+    p = outReserve(o, 256);
+
     // Fields 1 to 6 : SBS message type and ICAO address of the aircraft and some other stuff
-    p += sprintf(p, "MSG,%d,1,1,%06X,1,", msgType, mm->addr);
+    // Field 3 (session) tells which input file the message came from
+    p = fmtStr(p, "MSG,");
+    *p++ = '0' + msgType;
+    *p++ = ',';
+    p = fmtUInt(p, mm->input + 1);
+    p = fmtStr(p, ",1,");
+    p = fmtHex(p, mm->addr, 6, 1);
+    p = fmtStr(p, ",1,");
 
     // Find current system time
     clock_gettime(CLOCK_REALTIME, &now);
-    localtime_r(&now.tv_sec, &stTime_now);
-
-    // Find message reception time
-	if (Modes.useLocaltime) localtime_r(&mm->sysTimestampMsg.tv_sec, &stTime_receive);
-	else gmtime_r(&mm->sysTimestampMsg.tv_sec, &stTime_receive);
 
     // Fields 7 & 8 are the message reception time and date
-    p += sprintf(p, "%04d/%02d/%02d,", (stTime_receive.tm_year+1900),(stTime_receive.tm_mon+1), stTime_receive.tm_mday);
-    p += sprintf(p, "%02d:%02d:%02d.%03u,", stTime_receive.tm_hour, stTime_receive.tm_min, stTime_receive.tm_sec, (unsigned) (mm->sysTimestampMsg.tv_nsec / 1000000U));
+    p = fmtDate(p, &receive_date, mm->sysTimestampMsg.tv_sec, Modes.useLocaltime, ',');
+    p = fmtUIntPad(p, (unsigned) (mm->sysTimestampMsg.tv_nsec / 1000000U), 3);
+    *p++ = ',';
 
     // Fields 9 & 10 are the current time and date
-    p += sprintf(p, "%04d/%02d/%02d,", (stTime_now.tm_year+1900),(stTime_now.tm_mon+1), stTime_now.tm_mday);
-    p += sprintf(p, "%02d:%02d:%02d.%03u", stTime_now.tm_hour, stTime_now.tm_min, stTime_now.tm_sec, (unsigned) (now.tv_nsec / 1000000U));
+    p = fmtDate(p, &now_date, now.tv_sec, 1, ',');
+    p = fmtUIntPad(p, (unsigned) (now.tv_nsec / 1000000U), 3);
 
     // Field 11 is the callsign (if we have it)
-    if (mm->callsign_valid) {p += sprintf(p, ",%s", mm->callsign);}
-    else                    {p += sprintf(p, ",");}
+    *p++ = ',';
+    if (mm->callsign_valid) p = fmtStr(p, mm->callsign);
 
     // Field 12 is the altitude (if we have it)
+    *p++ = ',';
     if (mm->altitude_valid) {
         if (Modes.use_gnss) {
             if (mm->altitude_source == ALTITUDE_GNSS) {
-                p += sprintf(p, ",%dH", mm->altitude);
-            } else if (trackDataValid(&a->gnss_delta_valid)) {
-                p += sprintf(p, ",%dH", mm->altitude + a->gnss_delta);
+                p = fmtInt(p, mm->altitude);
+                *p++ = 'H';
+            } else if (mm->aircraft.gnss_delta_valid) {
+                p = fmtInt(p, mm->altitude + mm->aircraft.gnss_delta);
+                *p++ = 'H';
             } else {
-                p += sprintf(p, ",%d", mm->altitude);
+                p = fmtInt(p, mm->altitude);
             }
         } else {
             if (mm->altitude_source == ALTITUDE_BARO) {
-                p += sprintf(p, ",%d", mm->altitude);
-            } else if (trackDataValid(&a->gnss_delta_valid)) {
-                p += sprintf(p, ",%d", mm->altitude - a->gnss_delta);
-            } else {
-                p += sprintf(p, ",");
+                p = fmtInt(p, mm->altitude);
+            } else if (mm->aircraft.gnss_delta_valid) {
+                p = fmtInt(p, mm->altitude - mm->aircraft.gnss_delta);
             }
         }
-    } else {
-        p += sprintf(p, ",");
     }
 
     // Field 13 is the ground Speed (if we have it)
-    if (mm->speed_valid && mm->speed_source == SPEED_GROUNDSPEED) {
-        p += sprintf(p, ",%d", mm->speed);
-    } else {
-        p += sprintf(p, ",");
-    }
+    *p++ = ',';
+    if (mm->speed_valid && mm->speed_source == SPEED_GROUNDSPEED) p = fmtInt(p, mm->speed);
 
     // Field 14 is the ground Heading (if we have it)
-    if (mm->heading_valid && mm->heading_source == HEADING_TRUE) {
-        p += sprintf(p, ",%d", mm->heading);
-    } else {
-        p += sprintf(p, ",");
-    }
+    *p++ = ',';
+    if (mm->heading_valid && mm->heading_source == HEADING_TRUE) p = fmtInt(p, mm->heading);
 
     // Fields 15 and 16 are the Lat/Lon (if we have it)
-    if (mm->cpr_decoded) {
-        p += sprintf(p, ",%1.5f,%1.5f", mm->decoded_lat, mm->decoded_lon);
-    } else {
-        p += sprintf(p, ",,");
-    }
+    *p++ = ',';
+    if (mm->cpr_decoded) p = fmtFixed(p, mm->decoded_lat, 5);
+    *p++ = ',';
+    if (mm->cpr_decoded) p = fmtFixed(p, mm->decoded_lon, 5);
 
     // Field 17 is the VerticalRate (if we have it)
-    if (mm->vert_rate_valid) {
-        p += sprintf(p, ",%d", mm->vert_rate);
-    } else {
-        p += sprintf(p, ",");
-    }
+    *p++ = ',';
+    if (mm->vert_rate_valid) p = fmtInt(p, mm->vert_rate);
 
     // Field 18 is  the Squawk (if we have it)
-    if (mm->squawk_valid) {
-        p += sprintf(p, ",%04x", mm->squawk);
-    } else {
-        p += sprintf(p, ",");
-    }
+    *p++ = ',';
+    if (mm->squawk_valid) p = fmtHex(p, mm->squawk, 4, 0);
 
     // Field 19 is the Squawk Changing Alert flag (if we have it)
-    if (mm->alert_valid) {
-        if (mm->alert) {
-            p += sprintf(p, ",-1");
-        } else {
-            p += sprintf(p, ",0");
-        }
-    } else {
-        p += sprintf(p, ",");
-    }
+    *p++ = ',';
+    if (mm->alert_valid) p = fmtStr(p, mm->alert ? "-1" : "0");
 
     // Field 20 is the Squawk Emergency flag (if we have it)
+    *p++ = ',';
     if (mm->squawk_valid) {
         if ((mm->squawk == 0x7500) || (mm->squawk == 0x7600) || (mm->squawk == 0x7700)) {
-            p += sprintf(p, ",-1");
+            p = fmtStr(p, "-1");
         } else {
-            p += sprintf(p, ",0");
+            p = fmtStr(p, "0");
         }
-    } else {
-        p += sprintf(p, ",");
     }
 
     // Field 21 is the Squawk Ident flag (if we have it)
-    if (mm->spi_valid) {
-        if (mm->spi) {
-            p += sprintf(p, ",-1");
-        } else {
-            p += sprintf(p, ",0");
-        }
-    } else {
-        p += sprintf(p, ",");
-    }
+    *p++ = ',';
+    if (mm->spi_valid) p = fmtStr(p, mm->spi ? "-1" : "0");
 
     // Field 22 is the OnTheGround flag (if we have it)
+    *p++ = ',';
     switch (mm->airground) {
     case AG_GROUND:
-        p += sprintf(p, ",-1");
+        p = fmtStr(p, "-1");
         break;
     case AG_AIRBORNE:
-        p += sprintf(p, ",0");
+        *p++ = '0';
         break;
     default:
-        p += sprintf(p, ",");
         break;
     }
 
-    p += sprintf(p, "\r\n");
-
-    printf("%s", buffer);
+    *p++ = '\r';
+    *p++ = '\n';
 
+    outCommit(o, p);
 }
 
 //
@@ -352,26 +397,20 @@ static void modesSendSBSOutput(struct modesMessage *mm) {
 //
 // This function decodes a Beast binary format message
 //
-// The message is passed to the higher level layers, so it feeds
-// the selected screen output, the network output and so forth.
+// The message is left in mm for the higher level layers (the tracker and
+// the outputs, see pipeline.c).
 //
 // If the message looks invalid it is silently discarded.
 //
-// The function always returns 0 (success) to the caller as there is no
-// case where we want broken messages here to close the client connection.
+// Returns the length of the escaped frame if the message is to be passed
+// on, 0 if it was discarded (or only counted, with --only-find-icaos).
 //
-static int decodeBinMessage(char *p) {
+int decodeBinFrame(char *p, int input, uint64_t time_ns, struct modesMessage *mm) {
     int msgLen = 0;
     int msgrealLen = 0;
     int  j;
     char ch;
     unsigned char msg[MODES_LONG_MSG_BYTES];
-    static struct modesMessage zeroMessage;
-    struct modesMessage mm;
-
-    memset(&mm, 0, sizeof(mm));
-
-
 
     ch = *p++; /// Get the message type
     if (0x1A == ch) {ch=*p++;}
@@ -384,227 +423,330 @@ static int decodeBinMessage(char *p) {
         msgLen = MODES_LONG_MSG_BYTES;
     };
 
-    if (msgLen) {
-        mm = zeroMessage;
+    if (!msgLen)
+        return 0;
 
-        // Mark messages received over the internet as remote so that we don't try to
-        // pass them off as being received by this instance when forwarding them
-        mm.remote      =    0;
+    memset(mm, 0, sizeof(*mm));
 
-        // Grab the timestamp (big endian format)
-        mm.timestampMsg = 0;
-        for (j = 0; j < 6; j++) {
-            ch = *p++;
-            msgrealLen++;
-            mm.timestampMsg = mm.timestampMsg << 8 | (ch & 255);
-            if (0x1A == ch) {p++; msgrealLen++;}
-        }
+    // Mark messages received over the internet as remote so that we don't try to
+    // pass them off as being received by this instance when forwarding them
+    mm->remote      =    0;
+    mm->input       =    input;
 
+    // Grab the timestamp (big endian format)
+    mm->timestampMsg = 0;
+    for (j = 0; j < 6; j++) {
+        ch = *p++;
+        msgrealLen++;
+        mm->timestampMsg = mm->timestampMsg << 8 | (ch & 255);
+        if (0x1A == ch) {p++; msgrealLen++;}
+    }
 
-	    Modes.MLATtimefunc(&mm.sysTimestampMsg, mm.timestampMsg);
 
+    // Received now, or at the time of the receiver clock
+    if (Modes.mlat_decoder == MLAT_NONE) {
+        clock_gettime(CLOCK_REALTIME, &mm->sysTimestampMsg);
+    } else {
+        mm->sysTimestampMsg.tv_sec = time_ns / 1000000000ULL;
+        mm->sysTimestampMsg.tv_nsec = time_ns % 1000000000ULL;
+    }
 
-	    msgrealLen++;
-        ch = *p++;  // Grab the signal level
-        mm.signalLevel = ((unsigned char)ch / 255.0);
-        mm.signalLevel = mm.signalLevel * mm.signalLevel;
-        if (0x1A == ch) {p++; msgrealLen++;}
 
-        for (j = 0; j < msgLen; j++) { // and the data
-            msg[j] = ch = *p++;
-            msgrealLen++;
-            if (0x1A == ch) {p++; msgrealLen++;}
-        }
+    msgrealLen++;
+    ch = *p++;  // Grab the signal level
+    mm->signalLevel = ((unsigned char)ch / 255.0);
+    mm->signalLevel = mm->signalLevel * mm->signalLevel;
+    if (0x1A == ch) {p++; msgrealLen++;}
 
-        if (msgLen == MODEAC_MSG_BYTES) { // ModeA or ModeC
-            decodeModeAMessage(&mm, ((msg[0] << 8) | msg[1]));
-        } else {
-            int result;
+    for (j = 0; j < msgLen; j++) { // and the data
+        msg[j] = ch = *p++;
+        msgrealLen++;
+        if (0x1A == ch) {p++; msgrealLen++;}
+    }
 
-            result = decodeModesMessage(&mm, msg);
-            if (result < 0) {
-            	if(result == -1) Modes.err_not_known_ICAO++;
-            	if(result == -2) Modes.err_bad_crc++;
-            	return 0;}
+    if (msgLen == MODEAC_MSG_BYTES) { // ModeA or ModeC
+        decodeModeAMessage(mm, ((msg[0] << 8) | msg[1]));
+    } else {
+        int result;
 
-        }
+        result = decodeModesMessage(mm, msg);
+        if (result < 0)
+        	return result;
+    }
 
-        if(Modes.find_icao) {
-        	icaoAddtoDB(mm.addr);
-        }
-        else {
-    	if ((!Modes.show_only || mm.addr == Modes.show_only) || (Modes.show_only==0)) {
-            if (Modes.output_bb != -1) {
-            	msgrealLen += 2; // HEADER
-            	p-=msgrealLen;
-                j = write (Modes.output_bb, p, (ssize_t) (msgrealLen));
-    		if (j != msgrealLen) {
-    		fprintf(stderr, "Error. Write error in file %s\n",Modes.filename_extract);
-            return 2;
-    		}
-    		Modes.msg_extracted++;
-            }
-    	}
+    return msgrealLen + 2; // HEADER
+}
 
-		useModesMessage(&mm);
-		if(!Modes.quiet && Modes.sbs_output) modesSendSBSOutput(&mm);
+//
+// --mlat-drift: the rate of the dump1090 clock of an input is the slope of
+// the least squares line through its sync records (see struct mlatdrift).
+// The time base moves to the point of the line at each sync record, rather
+// than to the record itself whose time is late by the network and the
+// scheduler.
+//
+static void timeDrift(struct mlatclock *c, uint64_t timestamp, uint64_t unix_ns) {
+
+	struct mlatdrift *d = &c->drift;
+	double x, y, dx, b, a;
+	int64_t ticks;
+
+	if (d->n) {
+		ticks = (int64_t) ((timestamp - d->timestamp) << 16) >> 16;
+		x = (double) ticks;
+		y = (double) (int64_t) (unix_ns - d->ns);
+
+		// A feeder restarted or a clock stepped: the line is of no use
+		if (d->cxx > 0) {
+			b = d->cxy / d->cxx;
+			if (fabs(d->my + b * (x - d->mx) - y) > MLAT_DRIFT_RESET_NS)
+				d->n = 0;
+		}
+	}
+	if (!d->n) {
+		d->timestamp = timestamp;
+		d->ns = unix_ns;
+		d->mx = d->my = d->cxx = d->cxy = 0;
+		x = y = 0;
+	}
 
-        if((Modes.output_kml != NULL) && (Modes.show_only == mm.addr)) {
-            writeKMLcoordinates(Modes.output_kml, &mm);
-        }
-        }
-    }
-    return (0);
+	d->n++;
+	dx = x - d->mx;
+	d->mx += dx / d->n;
+	d->my += (y - d->my) / d->n;
+	d->cxx += dx * (x - d->mx);
+	d->cxy += dx * (y - d->my);
+
+	c->base_timestamp = timestamp;
+	c->base_ns = unix_ns;
+
+	if (d->n < 3 || x < MLAT_DRIFT_MIN_SEC * 12e6)
+		return;
+	b = d->cxy / d->cxx;
+	a = d->my - b * d->mx;
+	if (fabs(b * 12e6 / 1e9 - 1) * 1e6 > MLAT_DRIFT_MAX_PPM)
+		return;
+
+	c->rate = (uint64_t) (b * 4294967296.0 + 0.5);
+	c->base_ns = d->ns + (int64_t) (a + b * x);
+	d->ppm = (1e9 / 12e6 / b - 1) * 1e6;
+	d->estimates++;
 }
 
+void MLATtimePrintStats(FILE *f) {
+
+	struct mlatdrift *d;
+	int j;
+
+	if (!Modes.mlat_drift || Modes.mlat_decoder != MLAT_DUMP1090)
+		return;
+	// Every receiver has its own crystal
+	for (j = 0; j < Modes.ninputs; j++) {
+		d = &Modes.inputs[j].clock.drift;
+		if (Modes.ninputs > 1)
+			fprintf(f, "%s: ", Modes.inputs[j].filename);
+		if (d->estimates)
+			fprintf(f, "Receiver clock %+.2f ppm off 12 MHz, from %llu sync records\n", d->ppm, (long long unsigned) d->n);
+		else
+			fprintf(f, "Receiver clock rate not estimated, it takes sync records over %d s\n", MLAT_DRIFT_MIN_SEC);
+	}
+}
 
+// A sync record of --record: the time of the receiver clock on the wall
+// clock, which the messages after it are timed from
+static void timeSync(struct mlatclock *c, char *p) {
 
-// Experimental
+	uint64_t timestamp, unix_ns, day_ns;
 
-static int copyBinMessageSafe(char *p, int limit, char *out) {
-    int msgLen = 0;
-    int  j = 2;
-    char ch;
-	if (limit < 11) return -1; // Nothing to do
-    ch = *p;
-    if (0x1A == ch) {
-		p++;
-		*out = 0x1A;
-		out++;
-		} else return 0;
-
-	ch = *p;
-    if ((ch == '1')) {
-        msgLen = MODEAC_MSG_BYTES;
-		*out = '1';
-		out++;
-    } else if (ch == '2') {
-        msgLen = MODES_SHORT_MSG_BYTES;
-		*out = '2';
-		out++;
-    } else if (ch == '3') {
-        msgLen = MODES_LONG_MSG_BYTES;
-		*out = '3';
-		out++;
-    } else return 0;
+	recordParseSync(p, &timestamp, &unix_ns);
+	// A log starting with one starts at the frame it is for
+	if (!c->first)
+		c->first = timestamp;
+
+	switch (Modes.mlat_decoder) {
+	case MLAT_DUMP1090:
+		if (Modes.mlat_drift) {
+			timeDrift(c, timestamp, unix_ns);
+		} else {
+			c->base_timestamp = timestamp;
+			c->base_ns = unix_ns;
+		}
+		c->based = 1;
+		break;
+	case MLAT_BEAST:
+		// Seconds of day: the midnight nearest to the wall clock minus them
+		day_ns = (timestamp >> 30) * 1000000000ULL + (timestamp & BEAST_DROP_UPPER_34_BITS);
+		c->base_ns = (unix_ns - day_ns + 43200ULL * 1000000000ULL) / (86400ULL * 1000000000ULL) * (86400ULL * 1000000000ULL);
+		c->based = 1;
+		c->start = 0;
+		c->last_second = timestamp >> 30;
+		break;
+	default:
+		break;
+	}
+}
 
+uint64_t mlatClockTime(struct mlatclock *c, char *frame) {
 
+	uint64_t timestamp;
 
-    if (msgLen) {
-	   msgLen += 9;
-	   if (msgLen  > limit)   return -1;
-	   p++;
-        while ((j < msgLen)) {
+	if ((unsigned char) frame[1] == BEAST_SYNC_TYPE) {
+		timeSync(c, frame);
+		return c->last_ns;
+	}
 
-			if (msgLen > limit)   return -2;
-			*out = ch = *p++;
-			j++;
-			out++;
-			if (0x1A == ch) { msgLen++; *out = ch = *p++; out++; j++; }
-        }
-    }
-	if (msgLen > limit) return -3;
-	out -= msgLen;
-    return msgLen;
+	timestamp = frameTimestamp(frame);
+	if (!c->first)
+		c->first = c->base_timestamp = timestamp;
+
+	switch (Modes.mlat_decoder) {
+	case MLAT_BEAST:
+		// Not the made up timestamps of MLAT results, nor a missing one
+		if ((timestamp >> 30) < 86400 && timestamp)
+			c->last_ns = mlatBeast(c, timestamp);
+		break;
+	case MLAT_DUMP1090:
+		if (timestamp != MAGIC_MLAT_TIMESTAMP && timestamp)
+			c->last_ns = mlatDump1090(c, timestamp);
+		break;
+	default:
+		// 12MHz counter, comparable between logs of the same receiver
+		c->last_ns = timestamp * 1000 / 12;
+		break;
+	}
+	return c->last_ns;
 }
 
+int decodeBinMessage(char *p, int input, uint64_t time_ns, struct modesMessage *mm) {
+    int len;
 
-// Scan for header here -----------------------------------------------------
-// Now we only read first beast message and get it MLAT timestamp to relative
-// time calculations.
+    // Sync records are for mlatClockTime()
+    if ((unsigned char) p[1] == BEAST_SYNC_TYPE)
+        return 0;
 
-static void initMLATtime_dump(char *p, ssize_t size) {
+    len = decodeBinFrame(p, input, time_ns, mm);
 
-	char beastmessage[MAX_MSG_LEN];
-	ssize_t i, j, k = 0;
+    if (len <= 0) {
+    	if(len == -1) Modes.err_not_known_ICAO++;
+    	if(len == -2) Modes.err_bad_crc++;
+    	return 0;
+    }
 
-	while(k < size) {
+    if (Modes.batch_input)
+        batchAddIcao(mm->addr);
 
-	i = copyBinMessageSafe(p, BUF_SIZE - k, &beastmessage[0]);
+    if(Modes.find_icao) {
+    	icaoAddtoDB(mm);
+    	return 0;
+    }
 
-	if(i > 0) {
-	Modes.firsttimestampMsg = 0;
-	p = &beastmessage[2];
+    return len;
+}
 
-	for (j = 0; j < 6; j++) {
 
-            Modes.firsttimestampMsg = Modes.firsttimestampMsg << 8 | (*p & 255);
-            if (0x1A == *p) {p++;}
-			p++;
-        }
-	if (Modes.firsttimestampMsg) {
-		Modes.previoustimestampMsg = Modes.firsttimestampMsg;
-		break;
-	} else {p++; k++;}
 
-	} else {p++; k++;}
+// Receiver clock of a frame as returned by inputNextFrame()
+uint64_t frameTimestamp(char *p) {
+
+	uint64_t timestamp = 0;
+	int j;
 
+	p += 2;
+	for (j = 0; j < 6; j++) {
+		timestamp = timestamp << 8 | (*p & 255);
+		if (0x1A == *p) {p++;}
+		p++;
 	}
+	return timestamp;
 }
-// ------------------------------------------------------------------------
 
+static int processFrame(struct beastinput *in, char *frame, int len, long long unsigned first_msg) {
 
-int readbeastfile(void) {
-
-	ssize_t i,k,ret_in, seek;
-    char buffer[BUF_SIZE];
-	struct stat sb;
-	long long unsigned global;
-	char beastmessage[MAX_MSG_LEN];
-
-   fstat(Modes.input_bb, &sb);
+	// Sync records are no messages
+	if ((unsigned char) frame[1] != BEAST_SYNC_TYPE)
+		Modes.msg_processed++;
 
-   ret_in = read (Modes.input_bb, &buffer[0], BUF_SIZE);
+	sinkFrame(frame, len);
+	pipelineFrame(in, frame, len, Modes.show_progress && (Modes.msg_processed % 0xFFF  == 0));
 
-   if (Modes.mlat_decoder == MLAT_DUMP1090) {
-   initMLATtime_dump(&buffer[0], ret_in);
-   }
+	return (Modes.max_messages && (Modes.msg_processed - first_msg == Modes.max_messages));
+}
 
+//
+// Several inputs are merged into one stream ordered by message time:
+// every input holds its next frame, and a binary heap keyed by the time of
+// that frame tells which one goes next. Ties keep the order of the inputs.
+//
+static int mergeLess(struct beastinput *a, struct beastinput *b) {
+	return (a->frame_time < b->frame_time) || (a->frame_time == b->frame_time && a->index < b->index);
+}
 
+static void mergeSiftDown(struct beastinput **heap, int n, int i) {
 
-	seek = 0;
-	global = 0;
+	for (;;) {
+		int l = 2*i + 1, r = l + 1, m = i;
+		struct beastinput *t;
 
-	while((ret_in > 0) && (!Modes.exit)) {
+		if (l < n && mergeLess(heap[l], heap[m])) m = l;
+		if (r < n && mergeLess(heap[r], heap[m])) m = r;
+		if (m == i) return;
+		t = heap[i]; heap[i] = heap[m]; heap[m] = t;
+		i = m;
+	}
+}
 
-	k = 0;
+// Load the next frame of an input and its time on the clock of the input
+static int mergeFetch(struct beastinput *in) {
 
-	while(k < (ret_in + seek)) {
+	in->frame_len = inputNextFrame(in, in->frame);
+	if (in->frame_len > 0) {
+		in->frame_time = mlatClockTime(&in->clock, in->frame);
+	}
+	return in->frame_len;
+}
 
-	icaoFilterExpire();
-    trackPeriodicUpdate();
+static void readbeastmerge(long long unsigned first_msg) {
 
-	i = copyBinMessageSafe(&buffer[k], ret_in + seek - k, &beastmessage[0]);
-	if(i > 0) {
-	Modes.msg_processed++;
+	struct beastinput **heap = malloc(Modes.ninputs * sizeof(*heap));
+	int i, n = 0;
 
-	if (Modes.show_progress && (Modes.msg_processed % 0xFFF  == 0)) {printf("Processing... File offset 0x%llX (%llu%%), message #%llu\r", global, ((100*global)/(uint64_t)sb.st_size), Modes.msg_processed); }
-	decodeBinMessage(&beastmessage[0]);
+	for (i = 0; i < Modes.ninputs; i++) {
+		if (mergeFetch(&Modes.inputs[i]) > 0) heap[n++] = &Modes.inputs[i];
+	}
+	for (i = n/2 - 1; i >= 0; i--) mergeSiftDown(heap, n, i);
 
-	if (Modes.max_messages && (Modes.msg_processed == Modes.max_messages)) {return 0; }
+	while (n > 0 && !Modes.exit) {
+		struct beastinput *in = heap[0];
 
+		if (processFrame(in, in->frame, in->frame_len, first_msg)) break;
 
-	k+=i;
-	global+=i;
-	} else
-	   if(i == 0) {
-		if ((ret_in + seek - k) == 1) {
+		if (mergeFetch(in) <= 0) heap[0] = heap[--n];
+		mergeSiftDown(heap, n, 0);
+	}
 
-			break;
+	free(heap);
+}
 
-		}
-		else { k++; global++; }
-		}
-		else { break;}
+int readbeastfile(void) {
 
+	char beastmessage[MAX_MSG_LEN];
+	long long unsigned first_msg = Modes.msg_processed;
+	struct beastinput *in = &Modes.inputs[0];
+	int len;
 
+	if (Modes.ninputs > 1) {
+		readbeastmerge(first_msg);
+		return 0;
 	}
-	seek = BUF_SIZE - k;
-	if (seek > 0 ) memcpy(&buffer[0],&buffer[k], seek);
 
-	ret_in = read (Modes.input_bb, &buffer[seek], k);
+	// Addresses only: several threads may share a big log
+	if (Modes.find_icao && findIcaosParallel()) {
+		return 0;
 	}
 
+	while (!Modes.exit && (len = inputNextFrame(in, &beastmessage[0])) > 0) {
+		in->frame_time = mlatClockTime(&in->clock, &beastmessage[0]);
+		if (processFrame(in, &beastmessage[0], len, first_msg)) break;
+	}
 
     return 0;
 }
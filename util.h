@@ -39,11 +39,46 @@ int readbeastfile(void);
 struct timespec;
 void normalize_timespec(struct timespec *ts);
 
-// MLAT timestamps processors
-void MLATtime_none(struct timespec *msgTime, uint64_t mlatTimestamp);
-void MLATtime_beast(struct timespec *msgTime, uint64_t mlatTimestamp);
-void MLATtime_dump1090(struct timespec *msgTime, uint64_t mlatTimestamp);
+// A clock starting at start (NULL or zero if not known)
+struct mlatclock;
+void mlatClockInit(struct mlatclock *c, const struct timespec *start);
+
+// Time of a frame in ns: the real time with a time decoder, else the 12MHz
+// counter, only good to merge logs of one receiver. Frames must come in
+// the order of the input; sync records set the clock.
+uint64_t mlatClockTime(struct mlatclock *c, char *frame);
 
 int time_offset();
 
+// Keep the stop signals (SIGINT, SIGTERM, SIGHUP) away from the threads
+// started until the old mask is set again: they are the reader's
+void signalsBlock(sigset_t *old);
+
+// UNIX time "<seconds>[.<fraction>]" at s, exactly. Returns the characters
+// read, 0 if there is no number.
+int timeParse(const char *s, struct timespec *ts);
+
+// Time in the name of a log, "...--<seconds>.<nanoseconds>--...", as
+// flightdata.sh, --record and --blackbox write. Returns 0 if there is none.
+int timeFromFilename(const char *filename, struct timespec *ts);
+
+// Clock rate found by --mlat-drift
+void MLATtimePrintStats(FILE *f);
+
+struct outbuf;
+struct modesMessage;
+void modesSendSBSOutput(struct outbuf *o, struct modesMessage *mm);
+
+// Decode an escaped BEAST frame into mm, time_ns from mlatClockTime(),
+// returns the frame length if the message goes on to the tracker and the
+// outputs, 0 otherwise
+int decodeBinMessage(char *p, int input, uint64_t time_ns, struct modesMessage *mm);
+
+// Same without the bookkeeping: the frame length, 0 if the frame is not
+// decoded (Mode A/C off) or the negative result of decodeModesMessage
+int decodeBinFrame(char *p, int input, uint64_t time_ns, struct modesMessage *mm);
+
+// Receiver clock (48 bit) of an escaped BEAST frame
+uint64_t frameTimestamp(char *p);
+
 #endif